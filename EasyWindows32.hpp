@@ -26,14 +26,76 @@ SOFTWARE.
 
 #pragma once
 
+/*
+ * Варианты подключения:
+ *  - один заголовок (по умолчанию): файл подключается в одну .cpp и содержит всю реализацию вместе с WinMain;
+ *  - библиотека: с EZW32_LIBRARY заголовок можно подключать в любое число .cpp, он содержит только
+ *    объявления и подключает облегчённый Windows.h. Реализация собирается один раз в .cpp, где перед
+ *    подключением определён EZW32_IMPLEMENTATION (см. цель EasyWindows32Lib в CMakeLists.txt)
+ */
+#if !defined(EZW32_LIBRARY) || defined(EZW32_IMPLEMENTATION)
+    #define _M_EZW32_IMPLEMENT
+#endif
+
 #ifndef UNICODE
     #define UNICODE
 #endif
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#if defined(EZW32_LIBRARY) && !defined(_M_EZW32_IMPLEMENT) && !defined(WIN32_LEAN_AND_MEAN)
+    #define WIN32_LEAN_AND_MEAN
+#endif
 
 #include <Windows.h>
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+#include <array>
+#include <bit>
+#include <span>
+#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <limits>
+
+// Заголовки, нужные только реализации: в режиме библиотеки они не попадают в подключающие файлы
+#ifdef _M_EZW32_IMPLEMENT
+    #include <CommCtrl.h>
+    #include <wincodec.h>
+    #include <shellapi.h>
+    #include <unordered_map>
+    #include <thread>
+    #include <future>
+    #include <mutex>
+    #include <condition_variable>
+    #include <deque>
+    #include <list>
+    #include <chrono>
+
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #include <emmintrin.h>
+        #define _M_EZW32_SSE2
+    #endif
+
+    #ifdef _MSC_VER
+        #pragma comment(lib, "comctl32.lib")
+        #pragma comment(lib, "windowscodecs.lib")
+        #pragma comment(lib, "msimg32.lib")
+        #pragma comment(lib, "ole32.lib")
+        #pragma comment(lib, "shell32.lib")
+    #endif
+#endif
 
 #ifndef _M_EZW32_CLASS_NAME
     #define _M_EZW32_CLASS_NAME L"window_class"
@@ -43,6 +105,20 @@ SOFTWARE.
 #define _M_EZW32_ELEM_NAME_BUTTON L"button"
 #define _M_EZW32_ELEM_NAME_EDIT L"edit"
 #define _M_EZW32_ELEM_NAME_LISTBOX L"listbox"
+#define _M_EZW32_ELEM_NAME_PROGRESS L"msctls_progress32"
+#define _M_EZW32_ELEM_NAME_IMAGE L"static"
+#define _M_EZW32_ELEM_NAME_TREEVIEW L"SysTreeView32"
+
+#define _M_EZW32_WM_DELIVER_EVENT (WM_APP + 1)
+#define _M_EZW32_WM_IMAGE_LOADED (WM_APP + 2)
+#define _M_EZW32_WM_DROP_BATCH (WM_APP + 3)
+#define _M_EZW32_WM_TREE_UPDATE (WM_APP + 4)
+// ИД таймера опроса счётчиков (ИД элементов начинаются с 1 и с ним не пересекаются)
+#define _M_EZW32_SAMPLE_TIMER_ID ((UINT_PTR)-1)
+// Флаг ИД таймера вставки узлов TreeView (остальные биты - ИД элемента)
+#define _M_EZW32_TREE_TIMER_FLAG ((UINT_PTR)1 << (sizeof(UINT_PTR) * 8 - 1))
+
+LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 
 namespace easywindows32 {
@@ -70,6 +146,119 @@ protected:
     const char *m_msg;
 };
 
+/**
+ * @brief Удаление объекта, тип которого определён только в реализации (вызывается автоматически)
+ */
+template <class T>
+struct _M_HiddenDelete {
+    void operator ()(T *ptr) const;
+};
+// Владеющий указатель на такой объект: потоки, мьютексы и очереди внутри него не требуют своих заголовков у подключающих файлов
+template <class T>
+using _M_Hidden = std::unique_ptr<T, _M_HiddenDelete<T>>;
+
+/**
+ * @brief Перекодировать строку UTF-8 в UTF-16
+ * @details ASCII-участки обрабатываются блоками по 16 байт (SSE2); некорректные последовательности заменяются на U+FFFD.
+ *          Буфер результата переиспользуется: память выделяется, только если его ёмкости не хватает
+ * @param utf8 строка UTF-8
+ * @param out строка-результат
+ */
+void utf8ToUtf16(std::string_view utf8, std::wstring &out);
+
+/**
+ * @brief Перекодировать строку UTF-16 в UTF-8
+ * @details ASCII-участки обрабатываются блоками по 8 символов (SSE2); одиночные суррогаты заменяются на U+FFFD.
+ *          Буфер результата переиспользуется: память выделяется, только если его ёмкости не хватает
+ * @param utf16 строка UTF-16
+ * @param out строка-результат
+ */
+void utf16ToUtf8(std::wstring_view utf16, std::string &out);
+
+/**
+ * @brief Перекодировать строку UTF-8 во временный буфер потока
+ * @param utf8 строка UTF-8
+ * @return Ссылка на буфер (действительна до следующего вызова в этом потоке)
+ */
+inline const std::wstring &_m_utf8Scratch(std::string_view utf8) {
+    static thread_local std::wstring s_scratch;
+    utf8ToUtf16(utf8, s_scratch);
+    return s_scratch;
+}
+
+
+/**
+ * @brief Статистика кэша измерения текста
+ */
+struct TextMeasureStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+};
+
+/**
+ * @brief Кэш измерения текста
+ * @details Точные размеры (GetTextExtentPoint32) кэшируются по паре (дескриптор шрифта, строка); копии строк хранятся в кэше.
+ *          Для быстрой оценки новых строк хранятся таблицы ширин символов, загружаемые страницами по 256 символов.
+ *          Кэш свой у каждого потока, так как контекст устройства нельзя разделять между потоками
+ */
+class TextMeasure {
+public:
+    /**
+     * @brief Максимальное число закэшированных строк (при переполнении кэш сбрасывается)
+     */
+    static constexpr size_t s_maxEntries = 1 << 16;
+    /**
+     * @brief Максимальная суммарная длина закэшированных строк в символах (при переполнении кэш сбрасывается)
+     */
+    static constexpr size_t s_maxChars = 1 << 22;
+
+    /**
+     * @brief Измерить текст (точно, с кэшированием)
+     * @param font дескриптор шрифта (NULL - системный шрифт)
+     * @param text текст
+     * @return Размер текста в пикселях (высота - не меньше высоты строки)
+     */
+    static SIZE measure(HFONT font, std::wstring_view text);
+    /**
+     * @brief Оценить размер текста по таблице ширин символов (без обращения к GDI для уже загруженных символов)
+     * @details Не учитывает кернинг, поэтому может немного отличаться от measure
+     * @param font дескриптор шрифта (NULL - системный шрифт)
+     * @param text текст
+     * @return Примерный размер текста в пикселях
+     */
+    static SIZE estimate(HFONT font, std::wstring_view text);
+    /**
+     * @brief Получить высоту строки шрифта
+     * @param font дескриптор шрифта (NULL - системный шрифт)
+     * @return Высота строки в пикселях
+     */
+    static LONG getLineHeight(HFONT font);
+    /**
+     * @brief Получить статистику кэша текущего потока
+     * @return Статистика
+     */
+    static TextMeasureStats getStats();
+    /**
+     * @brief Очистить кэш текущего потока (например, после удаления шрифта)
+     */
+    static void clear();
+
+protected:
+    using _M_Page = std::array<uint16_t, 256>;
+
+    struct _M_Key;
+    struct _M_Probe;
+    struct _M_KeyHash;
+    struct _M_KeyEqual;
+    struct _M_FontData;
+    struct _M_Cache;
+
+    static _M_Cache &s_cache();
+    static HFONT s_resolve(HFONT font) { return font ? font : (HFONT)GetStockObject(SYSTEM_FONT); }
+};
+
+
 /**
  * @brief Класс-обёртка для шрифта
  */
@@ -107,6 +296,13 @@ public:
      */
     const HFONT getHandle() const { return m_handle; }
 
+    /**
+     * @brief Измерить текст этим шрифтом (с кэшированием, см. TextMeasure)
+     * @param text текст
+     * @return Размер текста в пикселях
+     */
+    SIZE measureText(std::wstring_view text) const { return TextMeasure::measure(m_handle, text); }
+
 protected:
     HFONT m_handle;
     LPCWSTR m_fontName;
@@ -115,6 +311,152 @@ protected:
 };
 
 
+/**
+ * @brief Флаги привязки элемента к краям окна (учитываются при изменении размера окна)
+ * @details Left|Right - элемент растягивается по ширине, только Right - сдвигается вместе с правым краем,
+ *          ни Left, ни Right - остаётся по центру (аналогично для Top/Bottom)
+ */
+enum class Anchor : uint8_t {
+    None    = 0,
+    Left    = 1 << 0,
+    Top     = 1 << 1,
+    Right   = 1 << 2,
+    Bottom  = 1 << 3,
+    All     = Left | Top | Right | Bottom
+};
+
+constexpr Anchor operator |(Anchor a, Anchor b) { return (Anchor)((uint8_t)a | (uint8_t)b); }
+constexpr Anchor operator &(Anchor a, Anchor b) { return (Anchor)((uint8_t)a & (uint8_t)b); }
+/**
+ * @brief Содержит ли набор флагов привязки указанный флаг?
+ * @param anchor набор флагов
+ * @param flag флаг
+ * @return T/F
+ */
+constexpr bool hasAnchor(Anchor anchor, Anchor flag) { return (anchor & flag) == flag; }
+
+
+/**
+ * @brief Энумерация режимов доставки событий элемента в ответную функцию
+ */
+enum class DeliveryMode {
+    Immediate,  // сразу, на каждое событие
+    Debounce,   // один раз, после паузы в событиях длиной interval мс
+    Throttle,   // не чаще раза в interval мс (первое событие - сразу, остальные сливаются в одно в конце интервала)
+    LatestOnly  // при следующем проходе цикла сообщений; накопившиеся к этому моменту события отбрасываются, кроме последнего
+};
+
+/**
+ * @brief Политика доставки событий элемента
+ */
+struct DeliveryPolicy {
+    DeliveryMode mode;
+    UINT interval;
+
+    /**
+     * @brief Доставлять каждое событие сразу
+     */
+    static constexpr DeliveryPolicy immediate() { return { DeliveryMode::Immediate, 0 }; }
+    /**
+     * @brief Доставлять одно событие после паузы
+     * @param ms длительность паузы в мс
+     */
+    static constexpr DeliveryPolicy debounce(UINT ms) { return { DeliveryMode::Debounce, ms }; }
+    /**
+     * @brief Доставлять события не чаще, чем раз в интервал
+     * @param ms интервал в мс
+     */
+    static constexpr DeliveryPolicy throttle(UINT ms) { return { DeliveryMode::Throttle, ms }; }
+    /**
+     * @brief Доставлять только последнее из накопившихся в очереди событий
+     */
+    static constexpr DeliveryPolicy latestOnly() { return { DeliveryMode::LatestOnly, 0 }; }
+};
+
+/**
+ * @brief Счётчики доставки событий элемента
+ */
+struct DeliveryStats {
+    uint64_t received;  // получено событий от Windows
+    uint64_t delivered; // вызовов ответной функции
+    uint64_t merged;    // событий, слитых с последующей доставкой (Debounce, Throttle)
+    uint64_t dropped;   // событий, вытесненных более новыми (LatestOnly)
+};
+
+
+struct _M_ResizeLayout;
+
+template <class T>
+inline void _m_writeValue(std::vector<uint8_t> &out, T value) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+// Строки хранятся как uint32 длина + UTF-16 без завершающего нуля
+inline void _m_writeString(std::vector<uint8_t> &out, std::wstring_view text) {
+    _m_writeValue<uint32_t>(out, (uint32_t)text.size());
+    size_t offset = out.size();
+    out.resize(offset + text.size() * 2);
+    if constexpr (sizeof(wchar_t) == 2) {
+        if (!text.empty())
+            std::memcpy(out.data() + offset, text.data(), text.size() * 2);
+    } else {
+        for (size_t i = 0; i < text.size(); i++) {
+            uint16_t unit = (uint16_t)text[i];
+            std::memcpy(out.data() + offset + i * 2, &unit, 2);
+        }
+    }
+}
+
+struct _M_ByteReader {
+    const uint8_t *m_ptr;
+    const uint8_t *m_end;
+    const char *m_error;
+    uint16_t m_version;     // версия читаемого формата
+
+    void m_require(size_t size) const {
+        if ((size_t)(m_end - m_ptr) < size)
+            throw Exception(m_error);
+    }
+    template <class T>
+    T m_read() {
+        m_require(sizeof(T));
+        T value;
+        std::memcpy(&value, m_ptr, sizeof(T));
+        m_ptr += sizeof(T);
+        return value;
+    }
+    void m_readString(std::wstring &out) {
+        uint32_t length = m_read<uint32_t>();
+        m_require((size_t)length * 2);
+        if constexpr (sizeof(wchar_t) == 2) {
+            out.assign((const wchar_t *)m_ptr, length);
+        } else {
+            out.resize(length);
+            for (size_t i = 0; i < length; i++) {
+                uint16_t unit;
+                std::memcpy(&unit, m_ptr + i * 2, 2);
+                out[i] = unit;
+            }
+        }
+        m_ptr += (size_t)length * 2;
+    }
+    // Строка без копирования: при 2-байтовом wchar_t - прямо в читаемых данных, иначе через scratch
+    std::wstring_view m_readStringView(std::wstring &scratch) {
+        if constexpr (sizeof(wchar_t) == 2) {
+            uint32_t length = m_read<uint32_t>();
+            m_require((size_t)length * 2);
+            std::wstring_view text((const wchar_t *)m_ptr, length);
+            m_ptr += (size_t)length * 2;
+            return text;
+        } else {
+            m_readString(scratch);
+            return scratch;
+        }
+    }
+};
+
 /**
  * @brief Абстрактный класс элемента UI
  */
@@ -128,9 +470,17 @@ public:
         m_className(className),
         m_id(++s_elemCount),
         m_handle(NULL),
-        m_font(s_fontDefault)
+        m_font(s_fontDefault),
+        m_anchor(Anchor::Left | Anchor::Top),
+        m_anchorVersion(nullptr),
+        m_delivery(DeliveryPolicy::immediate()),
+        m_deliveryStats(),
+        m_isEventPending(false),
+        m_isThrottling(false)
         { }
 
+    virtual ~IElement() = default;
+
     /**
      * @brief Получить ИД элемента
      * @return ИД
@@ -151,6 +501,42 @@ public:
      * @param font ссылка на шрифт
      */
     void setFont(const Font &font) { m_font = &font; }
+    /**
+     * @brief Получить привязку элемента к краям окна
+     * @return флаги привязки
+     */
+    const Anchor getAnchor() const { return m_anchor; }
+    /**
+     * @brief Установить привязку элемента к краям окна (по умолчанию Left | Top - элемент не двигается)
+     * @param anchor флаги привязки
+     */
+    void setAnchor(Anchor anchor) {
+        if (m_anchor == anchor)
+            return;
+        m_anchor = anchor;
+        if (m_anchorVersion)
+            (*m_anchorVersion)++;
+    }
+
+    /**
+     * @brief Получить политику доставки событий
+     * @return политика доставки
+     */
+    const DeliveryPolicy getDeliveryPolicy() const { return m_delivery; }
+    /**
+     * @brief Установить политику доставки событий в ответную функцию
+     * @param policy политика доставки
+     */
+    void setDeliveryPolicy(DeliveryPolicy policy) { m_delivery = policy; }
+    /**
+     * @brief Получить счётчики доставки событий
+     * @return счётчики
+     */
+    const DeliveryStats &getDeliveryStats() const { return m_deliveryStats; }
+    /**
+     * @brief Сбросить счётчики доставки событий
+     */
+    void resetDeliveryStats() { m_deliveryStats = { }; }
 
     /**
      * @brief Установить шрифт по умолчанию (автоматически применяется ко всем элементам, созданным после установки)
@@ -164,14 +550,102 @@ public:
      */
     virtual void create(HWND parent) = 0;
 
+    /**
+     * @brief Передать событие элемента в ответную функцию согласно политике доставки (вызывается автоматически)
+     * @param window дескриптор окна, в цикле сообщений которого работают таймеры доставки
+     */
+    void _m_submitEvent(HWND window) {
+        m_deliveryStats.received++;
+        switch (m_delivery.mode) {
+        case DeliveryMode::Immediate:
+            m_deliver();
+            break;
+        case DeliveryMode::Debounce:
+            if (m_isEventPending)
+                m_deliveryStats.merged++;
+            m_isEventPending = true;
+            SetTimer(window, (UINT_PTR)m_id, m_delivery.interval, NULL);
+            break;
+        case DeliveryMode::Throttle:
+            if (!m_isThrottling) {
+                m_isThrottling = true;
+                m_deliver();
+                SetTimer(window, (UINT_PTR)m_id, m_delivery.interval, NULL);
+            } else {
+                if (m_isEventPending)
+                    m_deliveryStats.merged++;
+                m_isEventPending = true;
+            }
+            break;
+        case DeliveryMode::LatestOnly:
+            if (m_isEventPending) {
+                m_deliveryStats.dropped++;
+            } else {
+                m_isEventPending = true;
+                PostMessage(window, _M_EZW32_WM_DELIVER_EVENT, (WPARAM)m_id, (LPARAM)NULL);
+            }
+            break;
+        }
+    }
+    /**
+     * @brief Обработать таймер доставки событий (вызывается автоматически)
+     * @param window дескриптор окна
+     */
+    void _m_onDeliveryTimer(HWND window) {
+        if (m_delivery.mode == DeliveryMode::Throttle && m_isEventPending) {
+            // Таймер продолжает работать: следующее событие снова ждёт конца интервала
+            m_isEventPending = false;
+            m_deliver();
+            return;
+        }
+        KillTimer(window, (UINT_PTR)m_id);
+        m_isThrottling = false;
+        if (m_isEventPending) {
+            m_isEventPending = false;
+            m_deliver();
+        }
+    }
+    /**
+     * @brief Обработать отложенную доставку события (вызывается автоматически)
+     */
+    void _m_onDeliveryPosted() {
+        if (!m_isEventPending)
+            return;
+        m_isEventPending = false;
+        m_deliver();
+    }
+
 protected:
-    static uint64_t s_elemCount;
-    static const Font *s_fontDefault;
+    friend struct _M_ResizeLayout;
+    friend class Window;
+
+    static inline std::atomic<uint64_t> s_elemCount = 0;
+    static inline const Font *s_fontDefault = nullptr;
 
     const uint64_t m_id;
     const LPCWSTR m_className;
     HWND m_handle;
     const Font *m_font;
+    Anchor m_anchor;
+    std::atomic<uint64_t> *m_anchorVersion;   // счётчик привязок окна, в которое добавлен элемент
+    DeliveryPolicy m_delivery;
+    DeliveryStats m_deliveryStats;
+    bool m_isEventPending;
+    bool m_isThrottling;
+
+    virtual void m_deliverEvent() { }
+
+    friend class Snapshot;
+
+    // Тип состояния в снимке (0 - элемент не сохраняется)
+    virtual uint16_t m_getStateType() const { return 0; }
+    virtual void m_saveState(std::vector<uint8_t> &/*out*/) { }
+    virtual void m_loadState(_M_ByteReader &/*in*/) { }
+
+    void m_deliver() {
+        m_deliveryStats.delivered++;
+        m_deliverEvent();
+    }
 
     void m_bindFont() {
         if (m_font)
@@ -180,9 +654,6 @@ protected:
 };
 
 
-uint64_t IElement::s_elemCount = 0;
-const Font *IElement::s_fontDefault = nullptr;
-
 /**
  * @brief Энумерация выравнивания элементов/текста
  */
@@ -223,6 +694,25 @@ public:
      * @return указатель на строку (c-style)
      */
     void setText(LPCWSTR text) { m_text = text; m_updateHandleText(); }
+    /**
+     * @brief Установить текст
+     * @param text строка UTF-8 (перекодируется без выделения памяти, если ёмкости текущего текста хватает)
+     */
+    void setText(std::string_view text) { utf8ToUtf16(text, m_text); m_updateHandleText(); }
+    /**
+     * @brief Получить текст в UTF-8
+     * @return Строка UTF-8
+     */
+    std::string getTextUtf8() const {
+        std::string result;
+        utf16ToUtf8(m_text, result);
+        return result;
+    }
+    /**
+     * @brief Получить текст в UTF-8
+     * @param out строка-результат (переиспользуется)
+     */
+    void getTextUtf8(std::string &out) const { utf16ToUtf8(m_text, out); }
 
 protected:
     std::wstring m_text;
@@ -278,12 +768,19 @@ public:
     const COORD getPos() const { return m_pos; }
 
 protected:
+    friend struct _M_ResizeLayout;
+
     COORD m_pos;
 };
 
 
 /**
- * @brief Абстрактный класс элемента UI с позицией
+ * @brief Значение ширины/высоты, при котором размер текстового элемента вычисляется по тексту и шрифту
+ */
+constexpr SHORT AutoSize = -1;
+
+/**
+ * @brief Абстрактный класс элемента UI с размером
  */
 class ISizeElement {
 public:
@@ -313,21 +810,260 @@ public:
     const COORD getSize() const { return m_size; }
 
 protected:
+    friend struct _M_ResizeLayout;
+
     COORD m_size;
+
+    void m_fitText(const Font *font, std::wstring_view text, SHORT padX, SHORT padY) {
+        if (m_size.X != AutoSize && m_size.Y != AutoSize)
+            return;
+        SIZE extent = TextMeasure::measure(font ? font->getHandle() : NULL, text);
+        if (m_size.X == AutoSize)
+            m_size.X = (SHORT)(extent.cx + 2*padX);
+        if (m_size.Y == AutoSize)
+            m_size.Y = (SHORT)(extent.cy + 2*padY);
+    }
+};
+
+
+/**
+ * @brief Прямоугольник элемента (результат вычисления разметки)
+ */
+struct LayoutRect {
+    SHORT x, y;
+    SHORT width, height;
+};
+
+/**
+ * @brief Энумерация выравнивания дочерних элементов поперёк ряда/колонки
+ */
+enum class LayoutAlign { Start, Center, End, Stretch };
+
+/**
+ * @brief Ячейка разметки (место под один элемент)
+ */
+struct LayoutCell {
+    static constexpr size_t s_count = 1;
+
+    SHORT width, height;
+
+    constexpr SHORT getWidth() const { return width; }
+    constexpr SHORT getHeight() const { return height; }
+
+    template <size_t N>
+    constexpr void place(std::array<LayoutRect, N> &out, size_t &index, LayoutRect area) const {
+        out[index++] = area;
+    }
+};
+
+/**
+ * @brief Пустое место в разметке (не создаёт ячейку)
+ */
+struct LayoutSpacer {
+    static constexpr size_t s_count = 0;
+
+    SHORT width, height;
+
+    constexpr SHORT getWidth() const { return width; }
+    constexpr SHORT getHeight() const { return height; }
+
+    template <size_t N>
+    constexpr void place(std::array<LayoutRect, N> &, size_t &, LayoutRect) const { }
+};
+
+/**
+ * @brief Ряд (isRow = T) или колонка (isRow = F) дочерних узлов разметки
+ * @tparam isRow направление
+ * @tparam Children типы дочерних узлов
+ */
+template <bool isRow, class... Children>
+struct LayoutStack {
+    static constexpr size_t s_count = (Children::s_count + ... + 0);
+
+    SHORT spacing;
+    LayoutAlign align;
+    std::tuple<Children...> children;
+
+    constexpr SHORT getWidth() const { return isRow ? m_mainSize() : m_crossSize(); }
+    constexpr SHORT getHeight() const { return isRow ? m_crossSize() : m_mainSize(); }
+
+    template <size_t N>
+    constexpr void place(std::array<LayoutRect, N> &out, size_t &index, LayoutRect area) const {
+        SHORT cursor = isRow ? area.x : area.y;
+        std::apply([&](const auto &...child) {
+            (m_placeChild(child, out, index, area, cursor), ...);
+        }, children);
+    }
+
+protected:
+    static constexpr SHORT s_mainOf(SHORT width, SHORT height) { return isRow ? width : height; }
+    static constexpr SHORT s_crossOf(SHORT width, SHORT height) { return isRow ? height : width; }
+
+    constexpr SHORT m_mainSize() const {
+        if constexpr (sizeof...(Children) == 0) {
+            return 0;
+        } else {
+            int size = spacing * (int)(sizeof...(Children) - 1);
+            std::apply([&](const auto &...child) {
+                ((size += s_mainOf(child.getWidth(), child.getHeight())), ...);
+            }, children);
+            return (SHORT)size;
+        }
+    }
+    constexpr SHORT m_crossSize() const {
+        SHORT size = 0;
+        std::apply([&](const auto &...child) {
+            ((size = std::max(size, s_crossOf(child.getWidth(), child.getHeight()))), ...);
+        }, children);
+        return size;
+    }
+
+    template <class Child, size_t N>
+    constexpr void m_placeChild(const Child &child, std::array<LayoutRect, N> &out, size_t &index, LayoutRect area, SHORT &cursor) const {
+        SHORT main = s_mainOf(child.getWidth(), child.getHeight());
+        SHORT cross = s_crossOf(child.getWidth(), child.getHeight());
+        SHORT areaCross = s_crossOf(area.width, area.height);
+        SHORT crossPos = isRow ? area.y : area.x;
+        switch (align) {
+        case LayoutAlign::Start:    break;
+        case LayoutAlign::Center:   crossPos += (areaCross - cross) / 2; break;
+        case LayoutAlign::End:      crossPos += areaCross - cross; break;
+        case LayoutAlign::Stretch:  cross = areaCross; break;
+        }
+        if constexpr (isRow)
+            child.place(out, index, { cursor, crossPos, main, cross });
+        else
+            child.place(out, index, { crossPos, cursor, cross, main });
+        cursor += main + spacing;
+    }
 };
 
+/**
+ * @brief Концепт узла разметки
+ */
+template <class T>
+concept LayoutNode = requires(const T &node) {
+    { T::s_count } -> std::convertible_to<size_t>;
+    { node.getWidth() } -> std::convertible_to<SHORT>;
+    { node.getHeight() } -> std::convertible_to<SHORT>;
+};
+
+/**
+ * @brief Создать ячейку разметки
+ * @param width ширина
+ * @param height высота
+ */
+constexpr LayoutCell layoutCell(SHORT width, SHORT height) { return { width, height }; }
+/**
+ * @brief Создать пустое место в разметке
+ * @param width ширина
+ * @param height высота
+ */
+constexpr LayoutSpacer layoutSpacer(SHORT width, SHORT height) { return { width, height }; }
+/**
+ * @brief Создать ряд (элементы слева направо)
+ * @param spacing расстояние между элементами
+ * @param align выравнивание по вертикали
+ * @param children дочерние узлы
+ */
+template <LayoutNode... Children>
+constexpr LayoutStack<true, Children...> layoutRow(SHORT spacing, LayoutAlign align, Children... children) {
+    return { spacing, align, { children... } };
+}
+/**
+ * @brief Создать ряд (элементы слева направо, выравнивание по верху)
+ * @param spacing расстояние между элементами
+ * @param children дочерние узлы
+ */
+template <LayoutNode... Children>
+constexpr LayoutStack<true, Children...> layoutRow(SHORT spacing, Children... children) {
+    return { spacing, LayoutAlign::Start, { children... } };
+}
+/**
+ * @brief Создать колонку (элементы сверху вниз)
+ * @param spacing расстояние между элементами
+ * @param align выравнивание по горизонтали
+ * @param children дочерние узлы
+ */
+template <LayoutNode... Children>
+constexpr LayoutStack<false, Children...> layoutColumn(SHORT spacing, LayoutAlign align, Children... children) {
+    return { spacing, align, { children... } };
+}
+/**
+ * @brief Создать колонку (элементы сверху вниз, выравнивание по левому краю)
+ * @param spacing расстояние между элементами
+ * @param children дочерние узлы
+ */
+template <LayoutNode... Children>
+constexpr LayoutStack<false, Children...> layoutColumn(SHORT spacing, Children... children) {
+    return { spacing, LayoutAlign::Start, { children... } };
+}
+
+/**
+ * @brief Вычислить прямоугольники всех ячеек разметки
+ * @details Если размеры известны при компиляции, результат можно сохранить в constexpr-переменную -
+ *          тогда во время работы программы разметка не вычисляется вовсе
+ * @param root корневой узел разметки
+ * @param posX X-координата левого верхнего угла
+ * @param posY Y-координата левого верхнего угла
+ * @return Таблица прямоугольников в порядке обхода ячеек (слева направо, сверху вниз)
+ */
+template <LayoutNode Node>
+constexpr std::array<LayoutRect, Node::s_count> computeLayout(const Node &root, SHORT posX = 0, SHORT posY = 0) {
+    std::array<LayoutRect, Node::s_count> rects { };
+    size_t index = 0;
+    root.place(rects, index, { posX, posY, root.getWidth(), root.getHeight() });
+    return rects;
+}
+
+/**
+ * @brief Вычислить прямоугольники ряда/колонки, число ячеек которой известно только во время работы
+ * @param isRow T - ряд, F - колонка
+ * @param spacing расстояние между элементами
+ * @param cells ячейки
+ * @param posX X-координата левого верхнего угла
+ * @param posY Y-координата левого верхнего угла
+ * @param align выравнивание поперёк направления = Start
+ * @return Таблица прямоугольников в порядке ячеек
+ */
+inline std::vector<LayoutRect> computeLayout(bool isRow, SHORT spacing, const std::vector<LayoutCell> &cells, SHORT posX = 0, SHORT posY = 0, LayoutAlign align = LayoutAlign::Start) {
+    SHORT cross = 0;
+    for (const LayoutCell &cell : cells)
+        cross = std::max(cross, isRow ? cell.height : cell.width);
+    std::vector<LayoutRect> rects;
+    rects.reserve(cells.size());
+    SHORT cursor = isRow ? posX : posY;
+    for (const LayoutCell &cell : cells) {
+        SHORT main = isRow ? cell.width : cell.height;
+        SHORT size = isRow ? cell.height : cell.width;
+        SHORT offset = 0;
+        switch (align) {
+        case LayoutAlign::Start:    break;
+        case LayoutAlign::Center:   offset = (cross - size) / 2; break;
+        case LayoutAlign::End:      offset = cross - size; break;
+        case LayoutAlign::Stretch:  size = cross; break;
+        }
+        if (isRow)
+            rects.push_back({ cursor, (SHORT)(posY + offset), main, size });
+        else
+            rects.push_back({ (SHORT)(posX + offset), cursor, size, main });
+        cursor += main + spacing;
+    }
+    return rects;
+}
+
 
 /**
  * @brief Класс-обёртка для статичного текстового элемента
  */
-class Static : public IElement, public ITextElement, public IPositionElement, ISizeElement {
+class Static : public IElement, public ITextElement, public IPositionElement, public ISizeElement {
 public:
     /**
      * @brief Конструктор
      * @param posX X-координата
      * @param posY Y-координата
-     * @param width ширина
-     * @param height высота
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
      * @param text текст = ""
      * @param alignText выравнивание = Center
      */
@@ -343,6 +1079,7 @@ public:
      * @param parent дескриптор родительского элемента
      */
     void create(HWND parent) override {
+        m_fitText(m_font, m_text, 2, 0);
         m_handle = CreateWindow(
             m_className,
             m_text.c_str(),
@@ -369,26 +1106,204 @@ template <class T>
 using FuncCall = void (*)(T &);
 
 /**
- * @brief Класс-обёртка для элемента кнопки
+ * @brief Ответная функция с захваченным состоянием (замена std::function без выделения памяти)
+ * @details Объекты размером до s_inlineSize байт хранятся внутри Callback, более крупные - в куче.
+ *          Вызов - один косвенный переход через указатель на функцию, без виртуальных методов
+ * @tparam T тип элемента, передаваемого в функцию
  */
-class Button : public IElement, public ITextElement, public IPositionElement, public ISizeElement {
+template <class T>
+class Callback {
+public:
+    /**
+     * @brief Размер внутреннего буфера для захваченных данных
+     */
+    static constexpr size_t s_inlineSize = 32;
+
+    /**
+     * @brief Конструктор по умолчанию (пустая функция)
+     */
+    Callback() : m_invoke(nullptr), m_manage(nullptr) { }
+    /**
+     * @brief Конструктор пустой функции
+     */
+    Callback(std::nullptr_t) : Callback() { }
+    /**
+     * @brief Конструктор
+     * @param func указатель на функцию (может быть NULL)
+     */
+    Callback(FuncCall<T> func) : Callback() {
+        if (func)
+            m_assign(func);
+    }
+    /**
+     * @brief Конструктор
+     * @tparam F тип вызываемого объекта (лямбда, функтор)
+     * @param func вызываемый объект с сигнатурой void(T &)
+     */
+    template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Callback> && std::is_invocable_v<std::decay_t<F> &, T &>>>
+    Callback(F &&func) : Callback() { m_assign(std::forward<F>(func)); }
+
+    /**
+     * @brief Конструктор копирования
+     * @param other другая функция
+     */
+    Callback(const Callback &other) : m_invoke(other.m_invoke), m_manage(other.m_manage) {
+        if (m_manage)
+            m_manage(_M_Op::Copy, m_storage, other.m_storage);
+        else
+            std::memcpy(m_storage, other.m_storage, s_inlineSize);
+    }
+    /**
+     * @brief Конструктор перемещения
+     * @param other другая функция (становится пустой)
+     */
+    Callback(Callback &&other) noexcept : Callback() { m_moveFrom(other); }
+
+    ~Callback() { m_reset(); }
+
+    /**
+     * @brief Присваивание копированием
+     * @param other другая функция
+     */
+    Callback &operator =(const Callback &other) {
+        if (this != &other) {
+            Callback tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+    /**
+     * @brief Присваивание перемещением
+     * @param other другая функция (становится пустой)
+     */
+    Callback &operator =(Callback &&other) noexcept {
+        if (this != &other) {
+            m_reset();
+            m_moveFrom(other);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Вызвать функцию
+     * @param elem элемент, переданный в функцию
+     * @warning Функция не должна быть пустой
+     */
+    void operator ()(T &elem) const { m_invoke(m_storage, elem); }
+
+    /**
+     * @brief Задана ли функция?
+     * @return T - функция задана, F - пустая
+     */
+    explicit operator bool() const { return (m_invoke != nullptr); }
+
+protected:
+    enum class _M_Op { Copy, Move, Destroy };
+
+    using _M_Invoker = void (*)(void *, T &);
+    using _M_Manager = void (*)(_M_Op, void *, void *);
+
+    alignas(std::max_align_t) mutable unsigned char m_storage[s_inlineSize];
+    _M_Invoker m_invoke;
+    _M_Manager m_manage;
+
+    template <class Fn>
+    static constexpr bool s_isInline = (sizeof(Fn) <= s_inlineSize && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>);
+
+    template <class F>
+    void m_assign(F &&func) {
+        using Fn = std::decay_t<F>;
+        if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn>) {
+            if (!func)
+                return;
+        }
+        if constexpr (s_isInline<Fn>) {
+            new (m_storage) Fn(std::forward<F>(func));
+            m_invoke = &s_invokeInline<Fn>;
+            // Тривиальные объекты (указатели на функции, лямбды с простыми захватами) копируются побайтово
+            m_manage = std::is_trivially_copyable_v<Fn> ? nullptr : &s_manageInline<Fn>;
+        } else {
+            *reinterpret_cast<Fn **>(m_storage) = new Fn(std::forward<F>(func));
+            m_invoke = &s_invokeHeap<Fn>;
+            m_manage = &s_manageHeap<Fn>;
+        }
+    }
+
+    void m_moveFrom(Callback &other) noexcept {
+        m_invoke = other.m_invoke;
+        m_manage = other.m_manage;
+        if (m_manage)
+            m_manage(_M_Op::Move, m_storage, other.m_storage);
+        else
+            std::memcpy(m_storage, other.m_storage, s_inlineSize);
+        other.m_invoke = nullptr;
+        other.m_manage = nullptr;
+    }
+
+    void m_reset() {
+        if (m_manage)
+            m_manage(_M_Op::Destroy, m_storage, nullptr);
+        m_invoke = nullptr;
+        m_manage = nullptr;
+    }
+
+    template <class Fn>
+    static void s_invokeInline(void *storage, T &elem) { (*std::launder(reinterpret_cast<Fn *>(storage)))(elem); }
+    template <class Fn>
+    static void s_invokeHeap(void *storage, T &elem) { (**reinterpret_cast<Fn **>(storage))(elem); }
+
+    template <class Fn>
+    static void s_manageInline(_M_Op op, void *dst, void *src) {
+        switch (op) {
+        case _M_Op::Copy:
+            new (dst) Fn(*std::launder(reinterpret_cast<const Fn *>(src)));
+            break;
+        case _M_Op::Move:
+            new (dst) Fn(std::move(*std::launder(reinterpret_cast<Fn *>(src))));
+            std::launder(reinterpret_cast<Fn *>(src))->~Fn();
+            break;
+        case _M_Op::Destroy:
+            std::launder(reinterpret_cast<Fn *>(dst))->~Fn();
+            break;
+        }
+    }
+    template <class Fn>
+    static void s_manageHeap(_M_Op op, void *dst, void *src) {
+        switch (op) {
+        case _M_Op::Copy:
+            *reinterpret_cast<Fn **>(dst) = new Fn(**reinterpret_cast<Fn **>(src));
+            break;
+        case _M_Op::Move:
+            *reinterpret_cast<Fn **>(dst) = *reinterpret_cast<Fn **>(src);
+            break;
+        case _M_Op::Destroy:
+            delete *reinterpret_cast<Fn **>(dst);
+            break;
+        }
+    }
+};
+
+/**
+ * @brief Класс-обёртка для элемента кнопки
+ */
+class Button : public IElement, public ITextElement, public IPositionElement, public ISizeElement {
 public:
     /**
      * @brief Конструктор
      * @param posX X-координата
      * @param posY Y-координата
-     * @param width ширина
-     * @param height высота
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
      * @param text текст = ""
      * @param onClick ответная функция на нажатие = NULL
      * @param alignText выравнивание = Center
      */
-    Button(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", FuncCall<Button> onClick = nullptr, Align alignText = Align::Center) :
+    Button(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Callback<Button> onClick = nullptr, Align alignText = Align::Center) :
         IElement(_M_EZW32_ELEM_NAME_BUTTON),
         ITextElement(text, alignText),
         IPositionElement(posX, posY),
         ISizeElement(width, height),
-        m_onClick(onClick)
+        m_onClick(std::move(onClick))
         { }
 
     /**
@@ -396,6 +1311,7 @@ public:
      * @param parent дескриптор родительского элемента
      */
     void create(HWND parent) override {
+        m_fitText(m_font, m_text, 10, 6);
         m_handle = CreateWindow(
             m_className,
             m_text.c_str(),
@@ -413,10 +1329,20 @@ public:
      * @brief Получить функцию при нажатии
      * @return ответная функция
      */
-    FuncCall<Button> getOnClick() { return m_onClick; }
+    const Callback<Button> &getOnClick() const { return m_onClick; }
+    /**
+     * @brief Установить функцию при нажатии
+     * @param onClick ответная функция
+     */
+    void setOnClick(Callback<Button> onClick) { m_onClick = std::move(onClick); }
 
 protected:
-    FuncCall<Button> m_onClick;
+    Callback<Button> m_onClick;
+
+    void m_deliverEvent() override {
+        if (m_onClick)
+            m_onClick(*this);
+    }
 
     _M_EZW32_I_TEXT_ELEMENT_UPDATE_HANDLE_TEXT_DEFINE()
     _M_EZW32_I_TEXT_ELEMENT_GET_TEXT_ALIGN_FLAG_DEFINE(BS_LEFT, BS_CENTER, BS_RIGHT)
@@ -432,8 +1358,8 @@ public:
      * @brief Конструктор
      * @param posX X-координата
      * @param posY Y-координата
-     * @param width ширина
-     * @param height высота
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
      * @param isNumberOnly только численный ввод (T/F) = F
      * @param alignText выравнивание текста = Left
      * @param presetText начальный текст = ""
@@ -451,6 +1377,7 @@ public:
      * @param parent дескриптор родительского элемента
      */
     void create(HWND parent) override {
+        m_fitText(m_font, m_text, 4, 4);
         m_handle = CreateWindow(
             m_className,
             m_text.c_str(),
@@ -466,6 +1393,8 @@ public:
 
     const std::wstring &getText() const = delete;
     const LPCWSTR getTextCstr() const = delete;
+    std::string getTextUtf8() const = delete;
+    void getTextUtf8(std::string &out) const = delete;
 
     /**
      * @brief Получить текст
@@ -477,10 +1406,47 @@ public:
      * @return Указатель на строку (c-style)
      */
     const LPCWSTR getTextCstr() { m_updateTextFromHandle(); return m_text.c_str(); }
+    /**
+     * @brief Получить текст в UTF-8
+     * @return Строка UTF-8
+     */
+    std::string getTextUtf8() {
+        std::string result;
+        getTextUtf8(result);
+        return result;
+    }
+    /**
+     * @brief Получить текст в UTF-8
+     * @param out строка-результат (переиспользуется)
+     */
+    void getTextUtf8(std::string &out) { m_updateTextFromHandle(); utf16ToUtf8(m_text, out); }
+
+    /**
+     * @brief Обработать изменение текста (вызывается автоматически)
+     */
+    virtual void _m_onTextChange() { }
+    /**
+     * @brief Выбрать цвета поля ввода (вызывается автоматически)
+     * @param hdc контекст устройства поля
+     * @return Кисть фона (NULL - цвета по умолчанию)
+     */
+    virtual HBRUSH _m_onCtlColor(HDC /*hdc*/) { return NULL; }
 
 protected:
     bool m_isNumberOnly;
 
+    uint16_t m_getStateType() const override { return 1; }
+    void m_saveState(std::vector<uint8_t> &out) override {
+        if (m_handle)
+            m_updateTextFromHandle();
+        _m_writeString(out, m_text);
+    }
+    void m_loadState(_M_ByteReader &in) override {
+        in.m_readString(m_text);
+        if (m_handle)
+            m_updateHandleText();
+    }
+
     void m_updateTextFromHandle() {
         int len = 1+GetWindowTextLength(m_handle);
         if (len == 1) {
@@ -488,7 +1454,7 @@ protected:
             return;
         }
         m_text.resize(len, '\0');
-        GetWindowText(m_handle, &m_text[0], len);
+        m_text.resize(GetWindowText(m_handle, &m_text[0], len));
     }
 
     _M_EZW32_I_TEXT_ELEMENT_UPDATE_HANDLE_TEXT_DEFINE()
@@ -497,427 +1463,5119 @@ protected:
 
 
 /**
- * @brief Класс-обёртка для элемента списка
+ * @brief Тип значения NumericEdit: целое (кроме bool) или с плавающей точкой
+ */
+template <class T>
+concept NumericValue = (std::integral<T> && !std::same_as<T, bool>) || std::floating_point<T>;
+
+/**
+ * @brief Класс поля ввода числа с диапазоном
+ * @details Текст разбирается (std::from_chars, без исключений) при каждом изменении, поэтому значение и его
+ *          корректность читаются без обращения к дескриптору. Некорректный ввод подсвечивается фоном
+ * @tparam T тип значения
  */
-class ListBox : public IElement, public IPositionElement, public ISizeElement {
+template <NumericValue T>
+class NumericEdit : public Edit {
 public:
+    /**
+     * @brief Цвет фона при некорректном вводе
+     */
+    static constexpr COLORREF s_invalidColor = RGB(255, 224, 224);
+
     /**
      * @brief Конструктор
      * @param posX X-координата
      * @param posY Y-координата
-     * @param width ширина
-     * @param height высота
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
+     * @param minimum минимальное значение = наименьшее значение T
+     * @param maximum максимальное значение = наибольшее значение T
+     * @param value начальное значение = 0
+     * @param alignText выравнивание текста = Right
      */
-    ListBox(SHORT posX, SHORT posY, SHORT width, SHORT height, FuncCall<ListBox> onSelect = nullptr) :
-        IElement(_M_EZW32_ELEM_NAME_LISTBOX),
-        IPositionElement(posX, posY),
-        ISizeElement(width, height),
-        m_onSelect(onSelect)
-        { }
+    NumericEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, T minimum = std::numeric_limits<T>::lowest(), T maximum = std::numeric_limits<T>::max(), T value = T(), Align alignText = Align::Right) :
+        Edit(posX, posY, width, height, false, alignText, s_format(value)),
+        m_minimum(minimum),
+        m_maximum(maximum),
+        m_value(value),
+        m_isValid(false)
+        { m_parse(); }
 
     /**
-     * @brief Инициализирует дескриптор и прикрепляет к нему шрифт и ранее добавленные элементы
+     * @brief Инициализирует дескриптор и прикрепляет к нему шрифт
      * @param parent дескриптор родительского элемента
      */
     void create(HWND parent) override {
-        m_handle = CreateWindow(
-            m_className,
-            L"",
-            WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY,
-            m_pos.X, m_pos.Y,
-            m_size.X, m_size.Y,
-            parent, (HMENU)m_id,
-            NULL,
-            NULL
-        );
-        m_bindFont();
-        for (auto &item : m_items)
-            SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)&item[0]);
+        Edit::create(parent);
+        m_parse();
     }
 
     /**
-     * @brief Получить ответную функцию
-     * @return ответная функция
+     * @brief Получить значение
+     * @return Последнее корректное значение
      */
-    FuncCall<ListBox> getOnSelect() { return m_onSelect; }
-
+    const T getValue() const { return m_value; }
     /**
-     * @brief Добавить элемент в список
-     * @param value значение элемента (c-style)
+     * @brief Корректен ли введённый текст (число в пределах диапазона)
+     * @return T/F
      */
-    void addItem(LPCSTR value) {
-        m_items.emplace_back(reinterpret_cast<const wchar_t *>(value));
-        if (m_handle) SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)value);
-    }
+    const bool isValid() const { return m_isValid; }
     /**
-     * @brief Добавить элемент в список
-     * @param value значение элемента
+     * @brief Установить значение (текст поля заменяется)
+     * @param value значение
      */
-    void addItem(const std::wstring &value) {
-        m_items.push_back(value);
-        if (m_handle) SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)value.c_str());
+    void setValue(T value) {
+        m_text = s_format(value);
+        m_updateHandleText();
+        m_parse();
     }
     /**
-     * @brief Удалить элемент из списка
-     * @param index индекс элемента, который нужно удалить
-     * @throws Если индекс не входит в границы списка (easywindows::Exception)
+     * @brief Получить минимальное значение
+     * @return значение
      */
-    void removeItem(int64_t index) {
-        if (index < 0 || index >= m_items.size())
-            throw Exception("Index out of range (easywindows32::ListBox::removeItem)");
-        SendMessage(m_handle, LB_DELETESTRING, (WPARAM)index, (LPARAM)NULL);
-        m_items.erase(m_items.begin() + index);
-    }
+    const T getMinimum() const { return m_minimum; }
     /**
-     * @brief Очистить список
+     * @brief Получить максимальное значение
+     * @return значение
      */
-    void clear() {
-        for (int64_t i = 0; i < m_items.size(); i++)
-            SendMessage(m_handle, LB_DELETESTRING, (WPARAM)0, (LPARAM)NULL);
-        m_items.clear();
-    }
-
+    const T getMaximum() const { return m_maximum; }
     /**
-     * @brief Получить индекс выделенного элемента
-     * @return Индекс выделенного элемента (если ни один не выбран, то LB_ERR)
+     * @brief Установить диапазон значений
+     * @param minimum минимальное значение
+     * @param maximum максимальное значение
      */
-    int64_t getSelectedIndex() const {
-        return SendMessage(m_handle, LB_GETCURSEL, (WPARAM)NULL, (LPARAM)NULL);
+    void setRange(T minimum, T maximum) {
+        m_minimum = minimum;
+        m_maximum = maximum;
+        m_parse();
     }
+
     /**
-     * @brief Получить значение выделенного элемента
-     * @return Текст выделенного элемента (std::wstring)
-     * @throws Если не выбран ни один элемент (easywindows32::Exception)
+     * @brief Разобрать изменившийся текст (вызывается автоматически)
      */
-    std::wstring getSelectedItem() const {
-        int64_t id = getSelectedIndex();
-        if (id == LB_ERR)
-            throw Exception("No item has been selected (easywindows32::ListBox::getSelectedItem)");
-        return m_items[id];
+    void _m_onTextChange() override {
+        m_updateTextFromHandle();
+        m_parse();
     }
     /**
-     * @brief Получить индекс элемента с определённым значением
-     * @param item значение элемента
-     * @return Индекс элемента (если эелемент не найден, то LB_ERR)
+     * @brief Подсветить некорректный ввод (вызывается автоматически)
+     * @param hdc контекст устройства поля
+     * @return Кисть фона (NULL - цвета по умолчанию)
      */
-    int64_t findItem(const std::wstring &item) const {
-        for (int64_t i = 0; i < m_items.size(); i++) {
-            if (m_items[i] == item)
-                return i;
-        }
-        return LB_ERR;
+    HBRUSH _m_onCtlColor(HDC hdc) override {
+        if (m_isValid)
+            return NULL;
+        static HBRUSH brush = CreateSolidBrush(s_invalidColor);
+        SetBkColor(hdc, s_invalidColor);
+        return brush;
     }
-    /**
-     * @brief Установить выделение на определённый элемент
-     * @param index индекс элемента, который нужно выделть (если -1, то выделение сбрасывается)
-     * @throws Если индекс не входит в границы списка (easywindows::Exception)
-     */
-    void setSelectedItem(int64_t index) const {
-        if (index < -1 || index >= (int64_t)m_items.size())
-            throw Exception("Index out of range (easywindows32::ListBox::setSelectedItem)");
-        SendMessage(m_handle, LB_SETCURSEL, (WPARAM)index, (LPARAM)NULL);
+
+protected:
+    T m_minimum;
+    T m_maximum;
+    T m_value;
+    bool m_isValid;
+
+    static std::wstring s_format(T value) {
+        char digits[64];
+        char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        return std::wstring(digits, end);
     }
-    /**
-     * @brief Сбросить выделение
-     */
-    void resetSelection() const {
-        SendMessage(m_handle, LB_SETCURSEL, (WPARAM)(-1), (LPARAM)NULL);
+
+    void m_parse() {
+        bool wasValid = m_isValid;
+        m_isValid = false;
+        size_t first = m_text.find_first_not_of(L" \t");
+        size_t last = m_text.find_last_not_of(L" \t");
+        // Число переводится в ASCII во временный буфер; любой другой символ делает ввод некорректным
+        char buffer[64];
+        size_t length = 0;
+        bool isAscii = (first != std::wstring::npos && last - first < sizeof(buffer));
+        for (size_t i = first; isAscii && i <= last; i++) {
+            if ((unsigned)m_text[i] > 0x7F)
+                isAscii = false;
+            buffer[length++] = (char)m_text[i];
+        }
+        if (isAscii) {
+            T value;
+            auto [ptr, error] = std::from_chars(buffer, buffer + length, value);
+            if (error == std::errc() && ptr == buffer + length && value >= m_minimum && value <= m_maximum) {
+                m_value = value;
+                m_isValid = true;
+            }
+        }
+        if (m_handle && m_isValid != wasValid)
+            InvalidateRect(m_handle, NULL, TRUE);
     }
 
-protected:
-    std::vector<std::wstring> m_items;
-    FuncCall<ListBox> m_onSelect;
+    void m_loadState(_M_ByteReader &in) override {
+        Edit::m_loadState(in);
+        m_parse();
+    }
 };
 
 
 /**
- * @brief Класс-обёртка ссылки на объект
- * @tparam T тип объекта
+ * @brief Абстрактный класс элемента, который рисует себя сам (WM_DRAWITEM/WM_MEASUREITEM окна)
  */
-template <class T>
-class Reference {
+class IOwnerDrawElement {
 public:
+    virtual ~IOwnerDrawElement() = default;
+
     /**
-     * @brief Конструктор по умолчанию
-     */
-    Reference() : m_ptr(nullptr) { };
-    /**
-     * @brief Конструктор
-     * @param ref lvalue-ссылка на объект
-     */
-    Reference(T &ref) : m_ptr(&ref) { };
-    /**
-     * @brief Конструктор
-     * @param ref rvalue-ссылка на объект
-     */
-    Reference(T &&ref) : m_ptr(&ref) { };
-    /**
-     * @brief Конструктор
-     * @param ref lvalue-ссылка на другую ссылку
-     */
-    Reference(const Reference<T> &ref) : m_ptr(ref->m_ptr) { };
-    /**
-     * @brief Конструктор
-     * @param ref rvalue-ссылка на другую ссылку
-     */
-    Reference(Reference<T> &&ref) : m_ptr(ref->m_ptr) { };
-    
-    /**
-     * @brief Установка значения
-     * @param ref lvalue-ссылка на объект
-     */
-    Reference &operator =(T &ref) { m_ptr = &ref; return *this; }
-    /**
-     * @brief Установка значения
-     * @param ref rvalue-ссылка на объект
-     */
-    Reference &operator =(T &&ref) { m_ptr = &ref; return *this; }
-    /**
-     * @brief Установка значения
-     * @param ref lvalue-ссылка на другую ссылку
+     * @brief Нарисовать элемент (вызывается автоматически)
+     * @param draw параметры рисования
      */
-    Reference &operator =(const Reference &ref) { m_ptr = ref.m_ptr; return *this; }
+    virtual void _m_drawItem(const DRAWITEMSTRUCT &draw) = 0;
     /**
-     * @brief Установка значения
-     * @param ref rvalue-ссылка на другую ссылку
+     * @brief Задать размеры элемента (вызывается автоматически)
+     * @param measure параметры измерения
      */
-    Reference &operator =(Reference &&ref) { m_ptr = ref.m_ptr; return *this; }
+    virtual void _m_measureItem(MEASUREITEMSTRUCT &/*measure*/) { }
     /**
-     * @brief Обращение к объекту
-     * @return указатель на объект
+     * @brief Обработать изменение размера по привязке (вызывается автоматически)
      */
-    T *operator ->() { return m_ptr; }
+    virtual void _m_onResized() { }
+};
 
-    /**
-     * @brief Получение объекта
-     * @return ссылка на объект
-     */
-    T &get() { return *m_ptr; }
 
-    /**
-     * @brief Хранит ли объект ссылку?
-     * @return T - объект ссылки пуст, F - имеет объект
-     */
-    bool isnull() const { return (m_ptr == nullptr); }
+/**
+ * @brief Абстрактный класс элемента, принимающего перетаскиваемые файлы (WM_DROPFILES окна)
+ */
+class IDropTargetElement {
+public:
+    virtual ~IDropTargetElement() = default;
 
     /**
-     * @brief Проверка равенства ссылок
-     * @param ref1 ссылка А
-     * @param ref2 ссылка на объект Б
+     * @brief Принимает ли элемент файлы сейчас (вызывается автоматически)
      * @return T/F
      */
-    friend bool operator ==(const Reference &ref1, const T &ref2) { return (ref1.m_ptr == &ref2); }
+    virtual bool _m_acceptsDrop() const = 0;
     /**
-     * @brief Проверка равенства ссылок
-     * @param ref1 ссылка А
-     * @param ref2 ссылка Б
-     * @return T/F
+     * @brief Принять перетащенные файлы и папки (вызывается автоматически)
+     * @param window дескриптор окна
+     * @param paths пути
      */
-    friend bool operator ==(const Reference &ref1, const Reference &ref2) { return (ref1.m_ptr == ref2.m_ptr); }
-
-protected:
-    T *m_ptr;
+    virtual void _m_onDrop(HWND window, std::vector<std::wstring> &&paths) = 0;
 };
 
+
 /**
- * @brief Ссылка на Static
+ * @brief Разрешить окну принимать перетаскиваемые файлы (DragAcceptFiles)
+ * @param window дескриптор окна
  */
-using RStatic = Reference<Static>;
+void _m_acceptDroppedFiles(HWND window);
+
 /**
- * @brief Ссылка на Button
+ * @brief Статистика приёма перетащенных файлов
  */
-using RButton = Reference<Button>;
+struct DropStats {
+    uint64_t paths;     // число найденных путей
+    uint64_t elapsed;   // время обхода в мкс (paths * 1000000 / elapsed - путей в секунду)
+};
+
+// Фоновый обход перетащенных файлов и папок (определён в реализации)
+struct _M_FileIntake;
+
 /**
- * @brief Ссылка на Edit
+ * @brief Ссылка на функцию void(size_t) без владения и выделения памяти (действительна, пока жива сама функция)
  */
-using REdit = Reference<Edit>;
+struct _M_TaskRef {
+    void *m_func;
+    void (*m_call)(void *func, size_t index);
+
+    template <class Func>
+        requires (!std::is_same_v<std::remove_cvref_t<Func>, _M_TaskRef>)
+    _M_TaskRef(Func &&func) :
+        m_func((void *)&func),
+        m_call([](void *f, size_t index) { (*(std::remove_reference_t<Func> *)f)(index); })
+        { }
+
+    void operator ()(size_t index) const { m_call(m_func, index); }
+};
+
 /**
- * @brief Ссылка на ListBox
+ * @brief Выполнить func(i) для i из [0, count) в отдельных потоках (последний - в вызывающем потоке)
  */
-using RListBox = Reference<ListBox>;
-
+void _m_parallelFor(size_t count, _M_TaskRef func);
+
+/**
+ * @brief Число частей для параллельной обработки count элементов (не меньше minChunk элементов в части)
+ */
+size_t _m_parallelChunks(size_t count, size_t minChunk);
+
+/**
+ * @brief Параллельная устойчивая сортировка перестановки индексов
+ * @details Части сортируются std::stable_sort в отдельных потоках, затем попарно сливаются (тоже параллельно)
+ * @param order перестановка индексов
+ * @param less функция сравнения индексов (не должна бросать исключения)
+ */
+template <class Less>
+void _m_parallelStableSort(std::vector<uint32_t> &order, Less less) {
+    size_t count = order.size();
+    size_t chunks = _m_parallelChunks(count, 1 << 14);
+    if (chunks < 2) {
+        std::stable_sort(order.begin(), order.end(), less);
+        return;
+    }
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t i = 0; i <= chunks; i++)
+        bounds[i] = count * i / chunks;
+    _m_parallelFor(chunks, [&](size_t i) {
+        std::stable_sort(order.begin() + bounds[i], order.begin() + bounds[i + 1], less);
+    });
+
+    std::vector<uint32_t> buffer(count);
+    while (bounds.size() > 2) {
+        size_t pairs = bounds.size() / 2;
+        _m_parallelFor(pairs, [&](size_t i) {
+            size_t low = bounds[2*i], mid = bounds[2*i + 1];
+            size_t high = (2*i + 2 < bounds.size()) ? bounds[2*i + 2] : mid;
+            // Левая часть идёт первой, поэтому при равенстве порядок сохраняется
+            std::merge(order.begin() + low, order.begin() + mid, order.begin() + mid, order.begin() + high, buffer.begin() + low, less);
+        });
+        std::vector<size_t> merged;
+        for (size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (merged.back() != count)
+            merged.push_back(count);
+        bounds.swap(merged);
+        order.swap(buffer);
+    }
+}
+
+
+/**
+ * @brief Способ хранения строк элементов списка (см. ListBox::setItemStorage)
+ */
+enum class ItemStorage {
+    Strings,    // отдельная std::wstring на каждый элемент
+    Packed,     // все строки в одном массиве символов, на элемент - 8 байт смещения и длины
+    Interned    // как Packed, но одинаковые строки хранятся один раз
+};
+
+/**
+ * @brief Хранилище строк элементов списка
+ * @details Строки в обоих режимах завершаются нулём, поэтому передаются списку без копирования
+ */
+struct _M_ItemStore {
+    static constexpr size_t s_maxLength = (1 << 24) - 1;
+
+    struct _M_Span {
+        uint64_t m_offset : 40;
+        uint64_t m_length : 24;
+    };
+    // Таблица строк Interned с числом ссылающихся элементов (определена в реализации)
+    struct _M_InternTable;
+
+    ItemStorage m_mode = ItemStorage::Strings;
+    std::vector<std::wstring> m_strings;
+    std::vector<wchar_t> m_chars;
+    std::vector<_M_Span> m_spans;
+    size_t m_garbage = 0;       // символы удалённых элементов, которые ещё занимают место в m_chars
+    _M_Hidden<_M_InternTable> m_interned;  // создаётся при первой строке Interned
+
+    _M_ItemStore() = default;
+    _M_ItemStore(const _M_ItemStore &) = delete;
+    _M_ItemStore &operator =(const _M_ItemStore &) = delete;
+
+    size_t size() const { return (m_mode == ItemStorage::Strings) ? m_strings.size() : m_spans.size(); }
+    bool empty() const { return size() == 0; }
+    std::wstring_view operator [](size_t index) const {
+        return (m_mode == ItemStorage::Strings) ? std::wstring_view(m_strings[index]) : m_view(m_spans[index]);
+    }
+    const wchar_t *c_str(size_t index) const {
+        return (m_mode == ItemStorage::Strings) ? m_strings[index].c_str() : m_chars.data() + m_spans[index].m_offset;
+    }
+
+    void reserve(size_t count, size_t chars) {
+        if (m_mode == ItemStorage::Strings) {
+            m_strings.reserve(count);
+            return;
+        }
+        m_spans.reserve(count);
+        // В режиме Interned повторы не занимают места, поэтому заранее резервировать все символы нельзя
+        if (m_mode == ItemStorage::Packed)
+            m_chars.reserve(chars);
+    }
+    void push_back(std::wstring_view text) {
+        if (m_mode == ItemStorage::Strings)
+            m_strings.emplace_back(text);
+        else
+            m_pack(text);
+    }
+    void push_back(std::wstring &&text) {
+        if (m_mode == ItemStorage::Strings)
+            m_strings.push_back(std::move(text));
+        else
+            m_pack(text);
+    }
+    void append(std::vector<std::wstring> &&texts) {
+        if (m_mode == ItemStorage::Strings && m_strings.empty()) {
+            m_strings = std::move(texts);
+            return;
+        }
+        size_t chars = 0;
+        if (m_mode != ItemStorage::Strings)
+            for (const std::wstring &text : texts)
+                chars += text.size() + 1;
+        reserve(size() + texts.size(), m_chars.size() + chars);
+        for (std::wstring &text : texts)
+            push_back(std::move(text));
+    }
+    void erase(size_t index) {
+        if (m_mode == ItemStorage::Strings) {
+            m_strings.erase(m_strings.begin() + index);
+            return;
+        }
+        m_release(m_spans[index]);
+        m_spans.erase(m_spans.begin() + index);
+        if (m_garbage > m_chars.size() / 2)
+            m_repack(m_mode);
+    }
+    void clear() {
+        m_strings.clear();
+        m_chars.clear();
+        m_spans.clear();
+        m_interned.reset();
+        m_garbage = 0;
+    }
+    // Элемент i становится элементом order[i]; в режимах Packed/Interned переставляются только смещения
+    void permute(const std::vector<uint32_t> &order) {
+        if (m_mode == ItemStorage::Strings) {
+            std::vector<std::wstring> strings(order.size());
+            for (size_t i = 0; i < order.size(); i++)
+                strings[i] = std::move(m_strings[order[i]]);
+            m_strings.swap(strings);
+        } else {
+            std::vector<_M_Span> spans(order.size());
+            for (size_t i = 0; i < order.size(); i++)
+                spans[i] = m_spans[order[i]];
+            m_spans.swap(spans);
+        }
+    }
+    // Оставляет только элементы kept (по возрастанию индексов)
+    void retain(const std::vector<uint32_t> &kept) {
+        if (m_mode != ItemStorage::Strings) {
+            size_t next = 0;
+            for (size_t i = 0; i < m_spans.size(); i++) {
+                if (next < kept.size() && kept[next] == i)
+                    next++;
+                else
+                    m_release(m_spans[i]);
+            }
+        }
+        permute(kept);
+        if (m_garbage > m_chars.size() / 2)
+            m_repack(m_mode);
+    }
+    void m_setMode(ItemStorage mode) {
+        if (mode == m_mode)
+            return;
+        if (mode != ItemStorage::Strings) {
+            m_repack(mode);
+            return;
+        }
+        std::vector<std::wstring> strings;
+        strings.reserve(m_spans.size());
+        for (_M_Span span : m_spans)
+            strings.emplace_back(m_view(span));
+        clear();
+        m_strings.swap(strings);
+        m_mode = mode;
+    }
+    // Память под строки: в режиме Strings - объекты строк и их буферы вне SSO
+    size_t m_bytes() const {
+        if (m_mode == ItemStorage::Strings) {
+            size_t bytes = m_strings.capacity() * sizeof(std::wstring);
+            const size_t inlineCapacity = std::wstring().capacity();
+            for (const std::wstring &text : m_strings)
+                if (text.capacity() > inlineCapacity)
+                    bytes += (text.capacity() + 1) * sizeof(wchar_t);
+            return bytes;
+        }
+        return m_chars.capacity() * sizeof(wchar_t) + m_spans.capacity() * sizeof(_M_Span) + m_internedBytes();
+    }
+
+    std::wstring_view m_view(_M_Span span) const { return std::wstring_view(m_chars.data() + span.m_offset, span.m_length); }
+
+    void m_pack(std::wstring_view text) {
+        if (text.size() > s_maxLength)
+            throw Exception("Item is too long (easywindows32::ListBox)");
+        m_spans.push_back((m_mode == ItemStorage::Interned) ? m_intern(text) : m_store(text));
+    }
+    _M_Span m_store(std::wstring_view text) {
+        _M_Span span = { m_chars.size(), text.size() };
+        m_chars.insert(m_chars.end(), text.begin(), text.end());
+        m_chars.push_back(L'\0');
+        return span;
+    }
+    // Элемент удаляется: его символы становятся мусором, если на строку Interned больше никто не ссылается
+    void m_release(_M_Span span) {
+        if (m_mode == ItemStorage::Interned && !m_unref(span))
+            return;
+        m_garbage += span.m_length + 1;
+    }
+    // Уже сохранённая строка Interned (число ссылок +1) или новая копия в m_chars
+    _M_Span m_intern(std::wstring_view text);
+    // Снимает ссылку на строку Interned; T - ссылок больше нет
+    bool m_unref(_M_Span span);
+    size_t m_internedBytes() const;
+    // Заново укладывает строки в режиме mode, отбрасывая символы удалённых элементов
+    void m_repack(ItemStorage mode) {
+        std::vector<std::wstring> strings;
+        std::vector<wchar_t> chars;
+        std::vector<_M_Span> spans;
+        strings.swap(m_strings);
+        chars.swap(m_chars);
+        spans.swap(m_spans);
+        bool isFromStrings = (m_mode == ItemStorage::Strings);
+        size_t count = isFromStrings ? strings.size() : spans.size();
+        clear();
+        m_mode = mode;
+        m_spans.reserve(count);
+        if (isFromStrings) {
+            size_t total = 0;
+            for (const std::wstring &text : strings)
+                total += text.size() + 1;
+            m_chars.reserve(total);
+            for (std::wstring &text : strings) {
+                m_pack(text);
+                std::wstring().swap(text);
+            }
+        } else {
+            m_chars.reserve(chars.size());
+            for (_M_Span span : spans)
+                m_pack(std::wstring_view(chars.data() + span.m_offset, span.m_length));
+        }
+    }
+};
+
+
+/**
+ * @brief Набор битов с числом установленных битов (выделение ListBox)
+ */
+struct _M_Bitset {
+    std::vector<uint64_t> m_words;
+    size_t m_size = 0;
+    size_t m_count = 0;
+    mutable std::vector<uint32_t> m_indices;    // номера установленных битов, строятся по запросу
+    mutable bool m_isDirty = false;
+
+    bool m_test(size_t index) const { return (m_words[index >> 6] >> (index & 63)) & 1; }
+
+    void m_resize(size_t size) {
+        m_words.resize((size + 63) >> 6, 0);
+        if (size < m_size) {
+            if (size & 63)
+                m_words.back() &= (1ull << (size & 63)) - 1;
+            m_count = 0;
+            for (uint64_t word : m_words)
+                m_count += std::popcount(word);
+            m_isDirty = true;
+        }
+        m_size = size;
+    }
+    void m_set(size_t index, bool value) {
+        uint64_t bit = 1ull << (index & 63);
+        uint64_t &word = m_words[index >> 6];
+        if (((word & bit) != 0) == value)
+            return;
+        word ^= bit;
+        m_count += value ? 1 : -1;
+        m_isDirty = true;
+    }
+    // Биты [first, last) меняются целыми словами
+    void m_setRange(size_t first, size_t last, bool value) {
+        for (size_t w = first >> 6; first < last; w++) {
+            size_t end = std::min(last, (w + 1) << 6);
+            uint64_t mask = ((end - first == 64) ? ~0ull : (1ull << (end - first)) - 1) << (first & 63);
+            m_count -= std::popcount(m_words[w]);
+            m_words[w] = value ? (m_words[w] | mask) : (m_words[w] & ~mask);
+            m_count += std::popcount(m_words[w]);
+            first = end;
+        }
+        m_isDirty = true;
+    }
+    void m_reset() {
+        std::fill(m_words.begin(), m_words.end(), 0);
+        m_count = 0;
+        m_isDirty = true;
+    }
+    // Удаляет бит index, сдвигая следующие биты на одну позицию
+    void m_erase(size_t index) {
+        if (m_test(index))
+            m_count--;
+        size_t w = index >> 6, bit = index & 63;
+        uint64_t low = m_words[w] & ((1ull << bit) - 1);
+        uint64_t high = (bit == 63) ? 0 : (m_words[w] >> (bit + 1)) << bit;
+        m_words[w] = low | high;
+        for (; w + 1 < m_words.size(); w++) {
+            m_words[w] |= m_words[w + 1] << 63;
+            m_words[w + 1] >>= 1;
+        }
+        m_resize(m_size - 1);
+        m_isDirty = true;
+    }
+    // Бит i становится битом order[i]
+    void m_permute(const std::vector<uint32_t> &order) {
+        std::vector<uint64_t> words((order.size() + 63) >> 6, 0);
+        for (size_t i = 0; i < order.size(); i++)
+            if (m_test(order[i]))
+                words[i >> 6] |= 1ull << (i & 63);
+        m_words.swap(words);
+        m_size = order.size();
+        m_count = 0;
+        for (uint64_t word : m_words)
+            m_count += std::popcount(word);
+        m_isDirty = true;
+    }
+    template <class Func>
+    void m_forEach(Func func) const {
+        for (size_t w = 0; w < m_words.size(); w++)
+            for (uint64_t word = m_words[w]; word; word &= word - 1)
+                func((w << 6) + std::countr_zero(word));
+    }
+    const std::vector<uint32_t> &m_list() const {
+        if (m_isDirty) {
+            m_indices.clear();
+            m_indices.reserve(m_count);
+            m_forEach([this](size_t index) { m_indices.push_back((uint32_t)index); });
+            m_isDirty = false;
+        }
+        return m_indices;
+    }
+};
+
+
+/**
+ * @brief Стиль элемента списка (см. ListBox::addStyle)
+ */
+struct ItemStyle {
+    COLORREF textColor = CLR_INVALID;   // CLR_INVALID - системный цвет текста
+    COLORREF backColor = CLR_INVALID;   // CLR_INVALID - системный цвет фона
+    HICON icon = NULL;                  // значок 16x16 слева от текста
+    bool isBold = false;
+};
+
+/**
+ * @brief Класс-обёртка для элемента списка
+ */
+class ListBox : public IElement, public IPositionElement, public ISizeElement, public IOwnerDrawElement, public IDropTargetElement {
+public:
+    /**
+     * @brief Конструктор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param onSelect ответная функция на выбор элемента = NULL
+     */
+    ListBox(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<ListBox> onSelect = nullptr) :
+        IElement(_M_EZW32_ELEM_NAME_LISTBOX),
+        IPositionElement(posX, posY),
+        ISizeElement(width, height),
+        m_onSelect(std::move(onSelect)),
+        m_styles(1),
+        m_isOwnerDraw(false),
+        m_boldFont(NULL),
+        m_itemHeight(0),
+        m_textOffset(0),
+        m_iconOffset(0),
+        m_isDropTarget(false),
+        m_isDropRecursive(true),
+        m_dropStats(),
+        m_isMultiSelect(false),
+        m_singleSelected(0)
+        { }
+
+    ~ListBox() override {
+        if (m_boldFont)
+            DeleteObject(m_boldFont);
+    }
+
+    /**
+     * @brief Инициализирует дескриптор и прикрепляет к нему шрифт и ранее добавленные элементы
+     * @param parent дескриптор родительского элемента
+     */
+    void create(HWND parent) override {
+        m_handle = CreateWindow(
+            m_className,
+            L"",
+            WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | (m_isOwnerDraw ? LBS_OWNERDRAWFIXED | LBS_HASSTRINGS : 0) | (m_isMultiSelect ? LBS_EXTENDEDSEL : 0),
+            m_pos.X, m_pos.Y,
+            m_size.X, m_size.Y,
+            parent, (HMENU)m_id,
+            NULL,
+            NULL
+        );
+        m_bindFont();
+        m_fillHandle(m_restoredSelection);
+        if (m_isDropTarget)
+            _m_acceptDroppedFiles(parent);
+    }
+
+    /**
+     * @brief Принимать перетаскиваемые файлы и папки
+     * @details Папки обходятся в фоновом потоке, найденные пути добавляются в список пачками. Если окно не успевает
+     *          добавлять пачки, обход приостанавливается, когда добавления ждут 65536 путей
+     * @param value T/F
+     * @param isRecursive обходить ли папки (F - добавляются пути самих папок) = T
+     */
+    void setDropTarget(bool value, bool isRecursive = true) {
+        m_isDropTarget = value;
+        m_isDropRecursive = isRecursive;
+        if (value && m_handle)
+            _m_acceptDroppedFiles(GetParent(m_handle));
+    }
+    /**
+     * @brief Принимает ли список перетаскиваемые файлы
+     * @return T/F
+     */
+    const bool isDropTarget() const { return m_isDropTarget; }
+    /**
+     * @brief Установить функцию, которая вызывается, когда все перетащенные пути добавлены в список
+     * @param onDropDone ответная функция
+     */
+    void setOnDropDone(Callback<ListBox> onDropDone) { m_onDropDone = std::move(onDropDone); }
+    /**
+     * @brief Идёт ли приём перетащенных файлов
+     * @return T/F
+     */
+    const bool isDropInProgress() const { return m_intake != nullptr; }
+    /**
+     * @brief Прервать приём перетащенных файлов (уже добавленные пути остаются в списке)
+     */
+    void cancelDrop();
+    /**
+     * @brief Получить статистику текущего или последнего приёма файлов
+     * @return Статистика
+     */
+    DropStats getDropStats() const;
+
+    /**
+     * @brief Включить самостоятельное рисование элементов списка со стилями (вызывать до открытия окна)
+     * @details Включается автоматически при добавлении первого стиля (см. addStyle)
+     * @param value T/F
+     */
+    void setOwnerDraw(bool value) { m_isOwnerDraw = value; }
+    /**
+     * @brief Рисует ли список элементы сам
+     * @return T/F
+     */
+    const bool isOwnerDraw() const { return m_isOwnerDraw; }
+    /**
+     * @brief Добавить стиль в палитру списка (стиль 0 - стиль по умолчанию)
+     * @details Элементы хранят только номер стиля (1 байт), поэтому палитра ограничена 256 стилями
+     * @param style стиль
+     * @return Номер стиля
+     * @throws Если в палитре уже 256 стилей (easywindows32::Exception)
+     */
+    uint8_t addStyle(const ItemStyle &style) {
+        if (m_styles.size() > UINT8_MAX)
+            throw Exception("Too many styles (easywindows32::ListBox::addStyle)");
+        m_styles.push_back(style);
+        if (!m_handle)
+            m_isOwnerDraw = true;
+        return (uint8_t)(m_styles.size() - 1);
+    }
+    /**
+     * @brief Получить стиль из палитры
+     * @param styleId номер стиля
+     * @return Ссылка на стиль
+     * @throws Если стиля с таким номером нет (easywindows32::Exception)
+     */
+    const ItemStyle &getStyle(uint8_t styleId) const {
+        if (styleId >= m_styles.size())
+            throw Exception("Style out of range (easywindows32::ListBox::getStyle)");
+        return m_styles[styleId];
+    }
+    /**
+     * @brief Установить стиль элемента
+     * @param index индекс элемента
+     * @param styleId номер стиля
+     * @throws Если индекс или номер стиля вне границ (easywindows32::Exception)
+     */
+    void setItemStyle(int64_t index, uint8_t styleId) {
+        if (index < 0 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::setItemStyle)");
+        if (styleId >= m_styles.size())
+            throw Exception("Style out of range (easywindows32::ListBox::setItemStyle)");
+        if (m_itemStyles[index] == styleId)
+            return;
+        m_itemStyles[index] = styleId;
+        m_invalidateItem(index);
+    }
+    /**
+     * @brief Получить номер стиля элемента
+     * @param index индекс элемента
+     * @return Номер стиля
+     * @throws Если индекс не входит в границы списка (easywindows32::Exception)
+     */
+    uint8_t getItemStyle(int64_t index) const {
+        if (index < 0 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::getItemStyle)");
+        return m_itemStyles[index];
+    }
+
+    /**
+     * @brief Установить способ хранения строк элементов (по умолчанию Strings)
+     * @details Packed и Interned хранят все строки в одном массиве символов: на миллионах коротких элементов это
+     *          в несколько раз меньше памяти и нет отдельного выделения на каждый элемент. Уже добавленные элементы
+     *          перекладываются в новое хранилище
+     * @param storage способ хранения
+     */
+    void setItemStorage(ItemStorage storage) { m_items.m_setMode(storage); }
+    /**
+     * @brief Получить способ хранения строк элементов
+     * @return способ хранения
+     */
+    const ItemStorage getItemStorage() const { return m_items.m_mode; }
+    /**
+     * @brief Получить объём памяти, занятой строками элементов (без копии строк в дескрипторе списка)
+     * @return Число байт
+     */
+    size_t getItemBytes() const { return m_items.m_bytes(); }
+
+    /**
+     * @brief Получить ответную функцию
+     * @return ответная функция
+     */
+    const Callback<ListBox> &getOnSelect() const { return m_onSelect; }
+    /**
+     * @brief Установить ответную функцию на выбор элемента
+     * @param onSelect ответная функция
+     */
+    void setOnSelect(Callback<ListBox> onSelect) { m_onSelect = std::move(onSelect); }
+
+    /**
+     * @brief Добавить элемент в список
+     * @param value значение элемента (UTF-8)
+     */
+    void addItem(std::string_view value) {
+        addItem(_m_utf8Scratch(value));
+    }
+    /**
+     * @brief Добавить элемент в список
+     * @param value значение элемента
+     */
+    void addItem(const std::wstring &value) {
+        m_items.push_back(std::wstring_view(value));
+        m_itemStyles.push_back(0);
+        m_selection.m_resize(m_items.size());
+        if (m_handle) SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)value.c_str());
+    }
+    /**
+     * @brief Добавить элемент со стилем в список
+     * @param value значение элемента
+     * @param styleId номер стиля (см. addStyle)
+     * @throws Если стиля с таким номером нет (easywindows32::Exception)
+     */
+    void addItem(const std::wstring &value, uint8_t styleId) {
+        if (styleId >= m_styles.size())
+            throw Exception("Style out of range (easywindows32::ListBox::addItem)");
+        m_items.push_back(std::wstring_view(value));
+        m_itemStyles.push_back(styleId);
+        m_selection.m_resize(m_items.size());
+        if (m_handle) SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)value.c_str());
+    }
+    /**
+     * @brief Добавить несколько элементов в список (перерисовка списка откладывается до конца добавления)
+     * @param values значения элементов
+     */
+    void addItems(const std::vector<std::wstring> &values) {
+        size_t first = m_items.size();
+        size_t chars = 0;
+        for (const std::wstring &value : values)
+            chars += value.size() + 1;
+        m_items.reserve(first + values.size(), m_items.m_chars.size() + chars);
+        for (const std::wstring &value : values)
+            m_items.push_back(std::wstring_view(value));
+        m_appendHandle(first);
+    }
+    /**
+     * @brief Добавить несколько элементов в список, забрав строки (перерисовка списка откладывается до конца добавления)
+     * @param values значения элементов
+     */
+    void addItems(std::vector<std::wstring> &&values) {
+        size_t first = m_items.size();
+        m_items.append(std::move(values));
+        m_appendHandle(first);
+    }
+    /**
+     * @brief Удалить элемент из списка
+     * @param index индекс элемента, который нужно удалить
+     * @throws Если индекс не входит в границы списка (easywindows::Exception)
+     */
+    void removeItem(int64_t index) {
+        if (index < 0 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::removeItem)");
+        SendMessage(m_handle, LB_DELETESTRING, (WPARAM)index, (LPARAM)NULL);
+        m_items.erase((size_t)index);
+        m_itemStyles.erase(m_itemStyles.begin() + index);
+        m_selection.m_erase((size_t)index);
+    }
+    /**
+     * @brief Очистить список
+     */
+    void clear() {
+        if (m_handle)
+            SendMessage(m_handle, LB_RESETCONTENT, (WPARAM)NULL, (LPARAM)NULL);
+        m_items.clear();
+        m_itemStyles.clear();
+        m_selection.m_resize(0);
+    }
+
+    /**
+     * @brief Получить индекс выделенного элемента
+     * @return Индекс выделенного элемента (если ни один не выбран, то LB_ERR); при множественном выделении - первого из них
+     */
+    int64_t getSelectedIndex() const {
+        if (!m_isMultiSelect)
+            return SendMessage(m_handle, LB_GETCURSEL, (WPARAM)NULL, (LPARAM)NULL);
+        const std::vector<uint32_t> &selected = m_selection.m_list();
+        return selected.empty() ? LB_ERR : (int64_t)selected.front();
+    }
+    /**
+     * @brief Получить значение выделенного элемента
+     * @return Текст выделенного элемента (std::wstring)
+     * @throws Если не выбран ни один элемент (easywindows32::Exception)
+     */
+    std::wstring getSelectedItem() const {
+        int64_t id = getSelectedIndex();
+        if (id == LB_ERR)
+            throw Exception("No item has been selected (easywindows32::ListBox::getSelectedItem)");
+        return std::wstring(m_items[id]);
+    }
+    /**
+     * @brief Получить значение выделенного элемента без копирования
+     * @return Текст выделенного элемента (действителен до следующего изменения списка)
+     * @throws Если не выбран ни один элемент (easywindows32::Exception)
+     */
+    std::wstring_view getSelectedItemView() const {
+        int64_t id = getSelectedIndex();
+        if (id == LB_ERR)
+            throw Exception("No item has been selected (easywindows32::ListBox::getSelectedItemView)");
+        return m_items[id];
+    }
+    /**
+     * @brief Получить значение элемента без копирования
+     * @param index индекс элемента
+     * @return Текст элемента (действителен до следующего изменения списка)
+     * @throws Если индекс не входит в границы списка (easywindows32::Exception)
+     */
+    std::wstring_view getItemView(int64_t index) const {
+        if (index < 0 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::getItemView)");
+        return m_items[index];
+    }
+    /**
+     * @brief Получить число элементов
+     * @return Число элементов
+     */
+    const size_t getItemCount() const { return m_items.size(); }
+    /**
+     * @brief Получить индекс элемента с определённым значением
+     * @param item значение элемента
+     * @return Индекс элемента (если эелемент не найден, то LB_ERR)
+     */
+    int64_t findItem(const std::wstring &item) const {
+        for (int64_t i = 0; i < (int64_t)m_items.size(); i++) {
+            if (m_items[i] == item)
+                return i;
+        }
+        return LB_ERR;
+    }
+    /**
+     * @brief Получить индекс элемента с определённым значением
+     * @param item значение элемента (UTF-8)
+     * @return Индекс элемента (если эелемент не найден, то LB_ERR)
+     */
+    int64_t findItem(std::string_view item) const {
+        return findItem(_m_utf8Scratch(item));
+    }
+    /**
+     * @brief Установить выделение на определённый элемент
+     * @param index индекс элемента, который нужно выделть (если -1, то выделение сбрасывается)
+     * @throws Если индекс не входит в границы списка (easywindows::Exception)
+     */
+    void setSelectedItem(int64_t index) {
+        if (index < -1 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::setSelectedItem)");
+        if (!m_isMultiSelect) {
+            SendMessage(m_handle, LB_SETCURSEL, (WPARAM)index, (LPARAM)NULL);
+            return;
+        }
+        resetSelection();
+        if (index == -1)
+            return;
+        m_selection.m_set((size_t)index, true);
+        if (m_handle)
+            SendMessage(m_handle, LB_SETSEL, (WPARAM)TRUE, (LPARAM)index);
+    }
+    /**
+     * @brief Сбросить выделение
+     */
+    void resetSelection() {
+        if (!m_isMultiSelect) {
+            SendMessage(m_handle, LB_SETCURSEL, (WPARAM)(-1), (LPARAM)NULL);
+            return;
+        }
+        m_selection.m_reset();
+        if (m_handle)
+            SendMessage(m_handle, LB_SETSEL, (WPARAM)FALSE, (LPARAM)(-1));
+    }
+
+    /**
+     * @brief Разрешить выделение нескольких элементов (Shift, Ctrl, мышь; вызывать до открытия окна)
+     * @details Выделение хранится в наборе битов, который обновляется по LBN_SELCHANGE, поэтому запросы
+     *          выделения не обращаются к дескриптору
+     * @param value T/F
+     */
+    void setMultiSelect(bool value) { m_isMultiSelect = value; }
+    /**
+     * @brief Разрешено ли выделение нескольких элементов
+     * @return T/F
+     */
+    const bool isMultiSelect() const { return m_isMultiSelect; }
+    /**
+     * @brief Выделен ли элемент
+     * @param index индекс элемента
+     * @return T/F
+     * @throws Если индекс не входит в границы списка (easywindows32::Exception)
+     */
+    bool isSelected(int64_t index) const {
+        if (index < 0 || index >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::isSelected)");
+        return m_isMultiSelect ? m_selection.m_test((size_t)index) : (getSelectedIndex() == index);
+    }
+    /**
+     * @brief Получить число выделенных элементов
+     * @return Число элементов
+     */
+    size_t getSelectedCount() const {
+        return m_isMultiSelect ? m_selection.m_count : (getSelectedIndex() != LB_ERR);
+    }
+    /**
+     * @brief Получить индексы выделенных элементов
+     * @return Индексы по возрастанию (действительны до следующего изменения списка или выделения)
+     */
+    std::span<const uint32_t> getSelectedIndices() const {
+        if (m_isMultiSelect)
+            return m_selection.m_list();
+        int64_t index = getSelectedIndex();
+        if (index == LB_ERR)
+            return { };
+        m_singleSelected = (uint32_t)index;
+        return { &m_singleSelected, 1 };
+    }
+    /**
+     * @brief Выделить или снять выделение с элементов [first, last] одним сообщением
+     * @param first индекс первого элемента
+     * @param last индекс последнего элемента
+     * @param isSelected выделить (T) или снять выделение (F) = T
+     * @throws Если индексы вне границ или список без множественного выделения (easywindows32::Exception)
+     */
+    void selectRange(int64_t first, int64_t last, bool isSelected = true) {
+        if (!m_isMultiSelect)
+            throw Exception("List is not multi-select (easywindows32::ListBox::selectRange)");
+        if (first < 0 || first > last || last >= (int64_t)m_items.size())
+            throw Exception("Index out of range (easywindows32::ListBox::selectRange)");
+        m_selection.m_setRange((size_t)first, (size_t)last + 1, isSelected);
+        if (!m_handle)
+            return;
+        // LB_SELITEMRANGEEX снимает выделение, когда первый индекс больше второго, поэтому один элемент меняется через LB_SETSEL
+        if (first == last)
+            SendMessage(m_handle, LB_SETSEL, (WPARAM)isSelected, (LPARAM)first);
+        else if (isSelected)
+            SendMessage(m_handle, LB_SELITEMRANGEEX, (WPARAM)first, (LPARAM)last);
+        else
+            SendMessage(m_handle, LB_SELITEMRANGEEX, (WPARAM)last, (LPARAM)first);
+    }
+    /**
+     * @brief Выделить все элементы одним сообщением
+     * @throws Если список без множественного выделения (easywindows32::Exception)
+     */
+    void selectAll() {
+        if (!m_isMultiSelect)
+            throw Exception("List is not multi-select (easywindows32::ListBox::selectAll)");
+        m_selection.m_setRange(0, m_items.size(), true);
+        if (m_handle)
+            SendMessage(m_handle, LB_SETSEL, (WPARAM)TRUE, (LPARAM)(-1));
+    }
+    /**
+     * @brief Удалить выделенные элементы
+     * @details Немного элементов удаляются из дескриптора по одному с конца, иначе дескриптор заполняется заново
+     *          одним проходом: каждое удаление сдвигает остаток списка
+     * @return Число удалённых элементов
+     */
+    size_t removeSelected() {
+        std::span<const uint32_t> selected = getSelectedIndices();
+        std::vector<uint32_t> removed(selected.begin(), selected.end());
+        if (removed.empty())
+            return 0;
+        std::vector<uint32_t> kept;
+        kept.reserve(m_items.size() - removed.size());
+        size_t next = 0;
+        for (uint32_t i = 0; i < (uint32_t)m_items.size(); i++) {
+            if (next < removed.size() && removed[next] == i)
+                next++;
+            else
+                kept.push_back(i);
+        }
+        std::vector<uint8_t> styles(kept.size());
+        for (size_t i = 0; i < kept.size(); i++)
+            styles[i] = m_itemStyles[kept[i]];
+        m_items.retain(kept);
+        m_itemStyles.swap(styles);
+        m_selection.m_resize(0);
+        m_selection.m_resize(m_items.size());
+        m_restoredSelection = LB_ERR;
+        if (!m_handle)
+            return removed.size();
+        if (removed.size() * 16 < kept.size()) {
+            SendMessage(m_handle, WM_SETREDRAW, (WPARAM)FALSE, (LPARAM)NULL);
+            for (auto it = removed.rbegin(); it != removed.rend(); ++it)
+                SendMessage(m_handle, LB_DELETESTRING, (WPARAM)*it, (LPARAM)NULL);
+            SendMessage(m_handle, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM)NULL);
+            InvalidateRect(m_handle, NULL, TRUE);
+        } else {
+            m_fillHandle(LB_ERR);
+        }
+        return removed.size();
+    }
+    /**
+     * @brief Обновить набор выделенных элементов по дескриптору (вызывается автоматически по LBN_SELCHANGE)
+     * @details Все выделенные индексы читаются одним сообщением LB_GETSELITEMS в буфер на m_items.size() индексов,
+     * который только растёт
+     */
+    void _m_syncSelection() {
+        if (!m_isMultiSelect || !m_handle)
+            return;
+        m_selection.m_reset();
+        if (m_items.empty())
+            return;
+        if (m_selScratch.size() < m_items.size())
+            m_selScratch.resize(m_items.size());
+        LRESULT count = SendMessage(m_handle, LB_GETSELITEMS, (WPARAM)m_selScratch.size(), (LPARAM)m_selScratch.data());
+        if (count == LB_ERR)
+            return;
+        for (LRESULT i = 0; i < count; i++)
+            if (m_selScratch[i] >= 0 && (size_t)m_selScratch[i] < m_items.size())
+                m_selection.m_set((size_t)m_selScratch[i], true);
+    }
+    /**
+     * @brief Выделить элементы в дескрипторе списка с множественным выбором (вызывается автоматически)
+     * @details Отправляется одно сообщение на каждую серию подряд идущих элементов; прежнее выделение не снимается
+     * @param handle дескриптор списка
+     * @param selected индексы по возрастанию
+     */
+    static void _m_sendSelection(HWND handle, std::span<const uint32_t> selected) {
+        for (size_t i = 0; i < selected.size(); ) {
+            size_t end = i + 1;
+            while (end < selected.size() && selected[end] == selected[end - 1] + 1)
+                end++;
+            if (end - i == 1)
+                SendMessage(handle, LB_SETSEL, (WPARAM)TRUE, (LPARAM)selected[i]);
+            else
+                SendMessage(handle, LB_SELITEMRANGEEX, (WPARAM)selected[i], (LPARAM)selected[end - 1]);
+            i = end;
+        }
+    }
+
+    /**
+     * @brief Отсортировать список (устойчиво, в несколько потоков) с сохранением выделения
+     * @details Сортируется перестановка индексов, затем элементы переставляются и передаются списку одним заполнением
+     * @param less функция сравнения bool(std::wstring_view, std::wstring_view); для нескольких ключей
+     *             можно сравнивать их по очереди или сортировать несколько раз, начиная с младшего ключа
+     * @warning Функция сравнения вызывается из нескольких потоков одновременно и не должна бросать исключения
+     */
+    template <class Less>
+    void sort(Less less) {
+        std::vector<uint32_t> order = m_sortOrder();
+        _m_parallelStableSort(order, [this, &less](uint32_t a, uint32_t b) { return less(m_items[a], m_items[b]); });
+        m_applyOrder(order);
+    }
+    /**
+     * @brief Отсортировать список в естественном порядке с учётом языка пользователя ("file2" < "file10", регистр не учитывается)
+     * @details Ключи сортировки (LCMapStringEx) строятся один раз для каждого элемента, после чего элементы сравниваются побайтово
+     * @param isDescending по убыванию = F
+     */
+    void sortNatural(bool isDescending = false) {
+        std::vector<std::string> keys(m_items.size());
+        size_t chunks = _m_parallelChunks(m_items.size(), 1 << 12);
+        _m_parallelFor(chunks, [&](size_t chunk) {
+            size_t end = m_items.size() * (chunk + 1) / chunks;
+            for (size_t i = m_items.size() * chunk / chunks; i < end; i++)
+                keys[i] = s_naturalKey(m_items[i]);
+        });
+        std::vector<uint32_t> order = m_sortOrder();
+        if (isDescending)
+            _m_parallelStableSort(order, [&keys](uint32_t a, uint32_t b) { return keys[b] < keys[a]; });
+        else
+            _m_parallelStableSort(order, [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        m_applyOrder(order);
+    }
+
+    /**
+     * @brief Задать высоту строк (вызывается автоматически)
+     * @param measure параметры измерения
+     */
+    void _m_measureItem(MEASUREITEMSTRUCT &measure) override {
+        m_updateMetrics();
+        measure.itemHeight = (UINT)m_itemHeight;
+    }
+    /**
+     * @brief Нарисовать строку списка (вызывается автоматически)
+     * @details Список присылает WM_DRAWITEM только для открывшихся строк, поэтому прокрутка не зависит от числа элементов
+     * @param draw параметры рисования
+     */
+    void _m_drawItem(const DRAWITEMSTRUCT &draw) override {
+        if (draw.itemAction == ODA_FOCUS) {
+            DrawFocusRect(draw.hDC, &draw.rcItem);
+            return;
+        }
+        if (draw.itemID == (UINT)-1 || draw.itemID >= m_items.size())
+            return;
+        m_updateMetrics();
+        const ItemStyle &style = m_styles[m_itemStyles[draw.itemID]];
+        std::wstring_view text = m_items[draw.itemID];
+        bool isSelected = (draw.itemState & ODS_SELECTED);
+
+        COLORREF back = isSelected ? GetSysColor(COLOR_HIGHLIGHT) : (style.backColor != CLR_INVALID ? style.backColor : GetSysColor(COLOR_WINDOW));
+        COLORREF fore = isSelected ? GetSysColor(COLOR_HIGHLIGHTTEXT) : (style.textColor != CLR_INVALID ? style.textColor : GetSysColor(COLOR_WINDOWTEXT));
+        COLORREF oldBack = SetBkColor(draw.hDC, back);
+        COLORREF oldFore = SetTextColor(draw.hDC, fore);
+        HGDIOBJ oldFont = style.isBold ? SelectObject(draw.hDC, m_boldFont) : NULL;
+
+        int textX = draw.rcItem.left + s_padding;
+        if (style.icon)
+            textX += s_iconSize + s_padding;
+        // ETO_OPAQUE заливает фон той же операцией, что выводит текст
+        ExtTextOut(draw.hDC, textX, draw.rcItem.top + m_textOffset, ETO_CLIPPED | ETO_OPAQUE, &draw.rcItem, text.data(), (UINT)text.size(), NULL);
+        if (style.icon)
+            DrawIconEx(draw.hDC, draw.rcItem.left + s_padding, draw.rcItem.top + m_iconOffset, style.icon, s_iconSize, s_iconSize, 0, NULL, DI_NORMAL);
+        if (draw.itemState & ODS_FOCUS)
+            DrawFocusRect(draw.hDC, &draw.rcItem);
+
+        if (oldFont)
+            SelectObject(draw.hDC, oldFont);
+        SetTextColor(draw.hDC, oldFore);
+        SetBkColor(draw.hDC, oldBack);
+    }
+
+    /**
+     * @brief Принимает ли список файлы сейчас (вызывается автоматически)
+     * @return T/F
+     */
+    bool _m_acceptsDrop() const override { return m_isDropTarget; }
+    /**
+     * @brief Начать фоновый приём перетащенных путей (вызывается автоматически)
+     * @details Если предыдущий приём ещё идёт, новые пути обходятся тем же потоком
+     * @param window дескриптор окна
+     * @param paths пути
+     */
+    void _m_onDrop(HWND window, std::vector<std::wstring> &&paths) override;
+    /**
+     * @brief Добавить в список готовую пачку путей (вызывается автоматически)
+     */
+    void _m_onDropBatch();
+
+protected:
+    static constexpr int s_padding = 2;
+    static constexpr int s_iconSize = 16;
+
+    _M_ItemStore m_items;
+    std::vector<uint8_t> m_itemStyles;     // номер стиля каждого элемента, параллельно m_items
+    Callback<ListBox> m_onSelect;
+    std::vector<ItemStyle> m_styles;
+    bool m_isOwnerDraw;
+    HFONT m_boldFont;
+    // Размеры строки считаются один раз: высота, смещение текста и значка по вертикали
+    int m_itemHeight;
+    int m_textOffset;
+    int m_iconOffset;
+    bool m_isDropTarget;
+    bool m_isDropRecursive;
+    _M_Hidden<_M_FileIntake> m_intake;
+    DropStats m_dropStats;
+    Callback<ListBox> m_onDropDone;
+    bool m_isMultiSelect;
+    _M_Bitset m_selection;                 // выделенные элементы при множественном выделении, параллельно m_items
+    std::vector<int> m_selScratch;
+    mutable uint32_t m_singleSelected;
+
+    std::vector<uint32_t> m_sortOrder() const {
+        if (m_items.size() > UINT32_MAX)
+            throw Exception("Too many items (easywindows32::ListBox::sort)");
+        std::vector<uint32_t> order(m_items.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        return order;
+    }
+    // Переставляет элементы и стили по order и перезаполняет дескриптор, сохраняя выделенный элемент
+    void m_applyOrder(const std::vector<uint32_t> &order) {
+        int64_t selected = m_handle ? getSelectedIndex() : m_restoredSelection;
+        int64_t newSelected = LB_ERR;
+        std::vector<uint8_t> styles(m_items.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            styles[i] = m_itemStyles[order[i]];
+            if ((int64_t)order[i] == selected)
+                newSelected = (int64_t)i;
+        }
+        m_items.permute(order);
+        m_itemStyles.swap(styles);
+        if (m_isMultiSelect)
+            m_selection.m_permute(order);
+        m_restoredSelection = newSelected;
+        if (m_handle)
+            m_fillHandle(newSelected);
+    }
+    // Ключ сортировки - последовательность байтов, побайтовое сравнение которых даёт порядок CompareStringEx
+    static std::string s_naturalKey(std::wstring_view text) {
+        const DWORD flags = LCMAP_SORTKEY | LINGUISTIC_IGNORECASE | SORT_DIGITSASNUMBERS;
+        int size = LCMapStringEx(LOCALE_NAME_USER_DEFAULT, flags, text.data(), (int)text.size(), NULL, 0, NULL, NULL, 0);
+        std::string key(std::max(size, 1), '\0');
+        LCMapStringEx(LOCALE_NAME_USER_DEFAULT, flags, text.data(), (int)text.size(), (LPWSTR)key.data(), size, NULL, NULL, 0);
+        key.resize(std::max(size, 1) - 1);  // без завершающего нуля
+        return key;
+    }
+
+    // Передаёт дескриптору элементы, добавленные в m_items начиная с first
+    void m_appendHandle(size_t first) {
+        m_itemStyles.resize(m_items.size(), 0);
+        m_selection.m_resize(m_items.size());
+        if (!m_handle)
+            return;
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)FALSE, (LPARAM)NULL);
+        m_reserveHandle(first, m_items.size());
+        for (size_t i = first; i < m_items.size(); i++)
+            SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)m_items.c_str(i));
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM)NULL);
+        InvalidateRect(m_handle, NULL, TRUE);
+    }
+
+    void m_updateMetrics() {
+        if (m_itemHeight)
+            return;
+        HFONT font = m_font ? m_font->getHandle() : (HFONT)GetStockObject(SYSTEM_FONT);
+        LOGFONT logFont = { };
+        GetObject(font, sizeof(logFont), &logFont);
+        logFont.lfWeight = FW_BOLD;
+        m_boldFont = CreateFontIndirect(&logFont);
+        int lineHeight = std::max(TextMeasure::getLineHeight(font), TextMeasure::getLineHeight(m_boldFont));
+        m_itemHeight = std::max(lineHeight, s_iconSize) + 2*s_padding;
+        m_textOffset = (m_itemHeight - lineHeight) / 2;
+        m_iconOffset = (m_itemHeight - s_iconSize) / 2;
+    }
+    void m_invalidateItem(int64_t index) {
+        if (!m_handle || !m_isOwnerDraw)
+            return;
+        RECT rect;
+        if (SendMessage(m_handle, LB_GETITEMRECT, (WPARAM)index, (LPARAM)&rect) != LB_ERR)
+            InvalidateRect(m_handle, &rect, FALSE);
+    }
+
+    // Резервирует память списка под элементы [first, last) одним сообщением
+    void m_reserveHandle(size_t first, size_t last) {
+        size_t chars = 0;
+        for (size_t i = first; i < last; i++)
+            chars += m_items[i].size() + 1;
+        SendMessage(m_handle, LB_INITSTORAGE, (WPARAM)(last - first), (LPARAM)(chars * sizeof(wchar_t)));
+    }
+    // Передаёт дескриптору набор выделенных элементов
+    void m_applySelection() {
+        _m_sendSelection(m_handle, m_selection.m_list());
+    }
+    // Заполняет дескриптор всеми элементами с отключённой перерисовкой
+    void m_fillHandle(int64_t selected) {
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)FALSE, (LPARAM)NULL);
+        SendMessage(m_handle, LB_RESETCONTENT, (WPARAM)NULL, (LPARAM)NULL);
+        m_reserveHandle(0, m_items.size());
+        for (size_t i = 0; i < m_items.size(); i++)
+            SendMessage(m_handle, LB_ADDSTRING, (WPARAM)NULL, (LPARAM)m_items.c_str(i));
+        if (m_isMultiSelect)
+            m_applySelection();
+        else if (selected >= 0 && selected < (int64_t)m_items.size())
+            SendMessage(m_handle, LB_SETCURSEL, (WPARAM)selected, (LPARAM)NULL);
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM)NULL);
+        InvalidateRect(m_handle, NULL, TRUE);
+    }
+
+    int64_t m_restoredSelection = LB_ERR;
+
+    uint16_t m_getStateType() const override { return 2; }
+    // Данные: выделенный элемент (int64), число элементов (uint64), строки элементов,
+    // с версии 2 - число выделенных элементов (uint32) и их индексы по возрастанию (uint32)
+    void m_saveState(std::vector<uint8_t> &out) override {
+        _m_writeValue<int64_t>(out, m_handle ? getSelectedIndex() : m_restoredSelection);
+        _m_writeValue<uint64_t>(out, m_items.size());
+        for (size_t i = 0; i < m_items.size(); i++)
+            _m_writeString(out, m_items[i]);
+        if (m_isMultiSelect) {
+            const std::vector<uint32_t> &selected = m_selection.m_list();
+            _m_writeValue<uint32_t>(out, (uint32_t)selected.size());
+            for (uint32_t index : selected)
+                _m_writeValue<uint32_t>(out, index);
+        } else {
+            _m_writeValue<uint32_t>(out, 0);
+        }
+    }
+    void m_loadState(_M_ByteReader &in) override {
+        int64_t selected = in.m_read<int64_t>();
+        uint64_t count = in.m_read<uint64_t>();
+        // Каждая строка занимает минимум 4 байта, так что заведомо неверное число элементов отсекается до выделения памяти
+        in.m_require((size_t)std::min<uint64_t>(count, SIZE_MAX / 4) * 4);
+        // Символов в записи не больше, чем осталось байт за вычетом длин строк; +1 на завершающий ноль каждой строки
+        size_t chars = ((size_t)(in.m_end - in.m_ptr) - (size_t)count * 4) / 2 + (size_t)count;
+        m_items.clear();
+        m_items.reserve((size_t)count, chars);
+        std::wstring scratch;
+        for (uint64_t i = 0; i < count; i++)
+            m_items.push_back(in.m_readStringView(scratch));
+        m_itemStyles.assign(m_items.size(), 0);
+        m_selection.m_resize(0);
+        m_selection.m_resize(m_items.size());
+        uint32_t selectedCount = in.m_version >= 2 ? in.m_read<uint32_t>() : 0;
+        if (m_isMultiSelect && selectedCount) {
+            in.m_require((size_t)selectedCount * 4);
+            for (uint32_t i = 0; i < selectedCount; i++) {
+                uint32_t index = in.m_read<uint32_t>();
+                if (index < m_items.size())
+                    m_selection.m_set(index, true);
+            }
+        } else if (m_isMultiSelect && selected >= 0 && selected < (int64_t)m_items.size()) {
+            m_selection.m_set((size_t)selected, true);
+        }
+        m_restoredSelection = selected;
+        if (m_handle)
+            m_fillHandle(selected);
+    }
+
+    void m_deliverEvent() override {
+        if (m_onSelect)
+            m_onSelect(*this);
+    }
+};
+
+
+/**
+ * @brief Абстрактный класс элемента, который периодически опрашивает счётчики из других потоков
+ * @details Окно опрашивает такие элементы по своему таймеру (см. Window::setSampleInterval),
+ *          поэтому частота обновления счётчиков не влияет на нагрузку на UI
+ */
+class ISampledElement {
+public:
+    virtual ~ISampledElement() = default;
+
+    /**
+     * @brief Считать счётчики и обновить дескриптор, если видимое значение изменилось (вызывается автоматически)
+     */
+    virtual void _m_sample() = 0;
+};
+
+
+/**
+ * @brief Класс полосы прогресса, привязанной к атомарному счётчику
+ * @details Рабочие потоки меняют счётчик (getCounter().fetch_add(1, std::memory_order_relaxed)) с любой частотой,
+ *          полоса перерисовывается только при смещении хотя бы на один пиксель
+ */
+class ProgressBar : public IElement, public IPositionElement, public ISizeElement, public ISampledElement {
+public:
+    /**
+     * @brief Конструктор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param maximum значение счётчика, соответствующее заполненной полосе = 100
+     */
+    ProgressBar(SHORT posX, SHORT posY, SHORT width, SHORT height, uint64_t maximum = 100) :
+        IElement(_M_EZW32_ELEM_NAME_PROGRESS),
+        IPositionElement(posX, posY),
+        ISizeElement(width, height),
+        m_ownCounter(0),
+        m_counter(&m_ownCounter),
+        m_maximum(maximum),
+        m_range(0),
+        m_shownPos(-1)
+        { }
+
+    /**
+     * @brief Получить счётчик (можно изменять из любого потока)
+     * @return Ссылка на счётчик
+     */
+    std::atomic<uint64_t> &getCounter() { return *m_counter; }
+    /**
+     * @brief Привязать полосу к внешнему счётчику (по умолчанию используется собственный)
+     * @param counter ссылка на счётчик (должен жить дольше полосы)
+     * @warning Вызывать до открытия окна или из его потока
+     */
+    void bindCounter(std::atomic<uint64_t> &counter) { m_counter = &counter; }
+    /**
+     * @brief Получить значение счётчика
+     * @return значение
+     */
+    const uint64_t getValue() const { return m_counter->load(std::memory_order_relaxed); }
+    /**
+     * @brief Установить значение счётчика (можно вызывать из любого потока)
+     * @param value значение
+     */
+    void setValue(uint64_t value) { m_counter->store(value, std::memory_order_relaxed); }
+    /**
+     * @brief Получить значение счётчика, соответствующее заполненной полосе
+     * @return значение
+     */
+    const uint64_t getMaximum() const { return m_maximum.load(std::memory_order_relaxed); }
+    /**
+     * @brief Установить значение счётчика, соответствующее заполненной полосе (можно вызывать из любого потока)
+     * @param maximum значение
+     */
+    void setMaximum(uint64_t maximum) { m_maximum.store(maximum, std::memory_order_relaxed); }
+
+    /**
+     * @brief Инициализирует дескриптор
+     * @param parent дескриптор родительского элемента
+     */
+    void create(HWND parent) override;
+
+    /**
+     * @brief Считать счётчик и сдвинуть полосу, если изменилось её положение в пикселях (вызывается автоматически)
+     */
+    void _m_sample() override;
+
+protected:
+    std::atomic<uint64_t> m_ownCounter;
+    std::atomic<uint64_t> *m_counter;
+    std::atomic<uint64_t> m_maximum;
+    int m_range;
+    int m_shownPos;
+};
+
+
+/**
+ * @brief Класс числового индикатора, привязанного к атомарному счётчику
+ * @details Показывает текст prefix + значение + suffix; текст меняется только при изменении значения
+ */
+class Meter : public IElement, public IPositionElement, public ISizeElement, public ISampledElement {
+public:
+    /**
+     * @brief Конструктор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param prefix текст перед значением = ""
+     * @param suffix текст после значения = ""
+     * @param alignText выравнивание = Center
+     */
+    Meter(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &prefix = L"", const std::wstring &suffix = L"", Align alignText = Align::Center) :
+        IElement(_M_EZW32_ELEM_NAME_STATIC),
+        IPositionElement(posX, posY),
+        ISizeElement(width, height),
+        m_ownCounter(0),
+        m_counter(&m_ownCounter),
+        m_prefix(prefix),
+        m_suffix(suffix),
+        m_alignText(alignText),
+        m_shownValue(0),
+        m_isShown(false)
+        { }
+
+    /**
+     * @brief Получить счётчик (можно изменять из любого потока)
+     * @return Ссылка на счётчик
+     */
+    std::atomic<uint64_t> &getCounter() { return *m_counter; }
+    /**
+     * @brief Привязать индикатор к внешнему счётчику (по умолчанию используется собственный)
+     * @param counter ссылка на счётчик (должен жить дольше индикатора)
+     * @warning Вызывать до открытия окна или из его потока
+     */
+    void bindCounter(std::atomic<uint64_t> &counter) { m_counter = &counter; }
+    /**
+     * @brief Получить значение счётчика
+     * @return значение
+     */
+    const uint64_t getValue() const { return m_counter->load(std::memory_order_relaxed); }
+    /**
+     * @brief Установить значение счётчика (можно вызывать из любого потока)
+     * @param value значение
+     */
+    void setValue(uint64_t value) { m_counter->store(value, std::memory_order_relaxed); }
+    /**
+     * @brief Установить текст вокруг значения
+     * @param prefix текст перед значением
+     * @param suffix текст после значения
+     * @warning Вызывать до открытия окна или из его потока
+     */
+    void setLabel(const std::wstring &prefix, const std::wstring &suffix = L"") {
+        m_prefix = prefix;
+        m_suffix = suffix;
+        m_isShown = false;
+        _m_sample();
+    }
+
+    /**
+     * @brief Инициализирует дескриптор и прикрепляет к нему шрифт
+     * @param parent дескриптор родительского элемента
+     */
+    void create(HWND parent) override {
+        DWORD alignFlag = (m_alignText == Align::Left) ? SS_LEFT : (m_alignText == Align::Right) ? SS_RIGHT : SS_CENTER;
+        m_handle = CreateWindow(
+            m_className,
+            NULL,
+            WS_CHILD | WS_VISIBLE | alignFlag | SS_CENTERIMAGE,
+            m_pos.X, m_pos.Y,
+            m_size.X, m_size.Y,
+            parent, (HMENU)m_id,
+            NULL,
+            NULL
+        );
+        m_bindFont();
+        m_isShown = false;
+        _m_sample();
+    }
+
+    /**
+     * @brief Считать счётчик и обновить текст, если значение изменилось (вызывается автоматически)
+     */
+    void _m_sample() override {
+        if (!m_handle)
+            return;
+        uint64_t value = m_counter->load(std::memory_order_relaxed);
+        if (m_isShown && value == m_shownValue)
+            return;
+        m_isShown = true;
+        m_shownValue = value;
+
+        char digits[20];
+        char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        // Буфер текста переиспользуется между обновлениями
+        m_text.assign(m_prefix);
+        m_text.append(digits, end);
+        m_text.append(m_suffix);
+        SetWindowText(m_handle, m_text.c_str());
+    }
+
+protected:
+    std::atomic<uint64_t> m_ownCounter;
+    std::atomic<uint64_t> *m_counter;
+    std::wstring m_prefix;
+    std::wstring m_suffix;
+    std::wstring m_text;
+    Align m_alignText;
+    uint64_t m_shownValue;
+    bool m_isShown;
+};
+
+
+/**
+ * @brief Статистика кэша изображений
+ */
+struct ImageCacheStats {
+    uint64_t hits;      // загрузки и перерисовки, для которых нужный вариант уже был в кэше
+    uint64_t misses;    // загрузки, которым пришлось декодировать или масштабировать изображение
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t budget;
+};
+
+/**
+ * @brief Декодированное изображение в кэше (32 бит на пиксель, BGRA с домноженной альфой)
+ */
+struct _M_ImageBitmap {
+    HBITMAP m_bitmap;               // DIB-секция варианта под размер элемента (NULL у исходника)
+    std::vector<uint8_t> m_pixels;  // пиксели исходника (пусто у варианта)
+    UINT m_width, m_height;
+    size_t m_bytes;
+
+    _M_ImageBitmap() : m_bitmap(NULL), m_width(0), m_height(0), m_bytes(0) { }
+    _M_ImageBitmap(const _M_ImageBitmap &) = delete;
+    _M_ImageBitmap &operator =(const _M_ImageBitmap &) = delete;
+    ~_M_ImageBitmap() { if (m_bitmap) DeleteObject(m_bitmap); }
+};
+
+/**
+ * @brief Общий кэш декодированных изображений с вытеснением давно не использованных (LRU)
+ * @details Изображения декодируются через WIC в фоновом потоке. Исходник и каждый его вариант под размер элемента
+ *          хранятся отдельными записями, поэтому перерисовка элемента - одно копирование готового растра.
+ *          Элементы с одинаковым источником и размером разделяют одну запись
+ */
+class ImageCache {
+    friend class Image;
+
+public:
+    /**
+     * @brief Установить бюджет памяти кэша (по умолчанию 64 МиБ)
+     * @details Изображения, которые сейчас показаны элементами, освобождаются после вытеснения только вместе с элементами
+     * @param bytes бюджет в байтах
+     */
+    static void setBudget(size_t bytes);
+    /**
+     * @brief Получить бюджет памяти кэша
+     * @return бюджет в байтах
+     */
+    static size_t getBudget();
+    /**
+     * @brief Получить статистику кэша
+     * @return Статистика
+     */
+    static ImageCacheStats getStats();
+    /**
+     * @brief Очистить кэш и статистику
+     */
+    static void clear();
+
+    struct _M_Job {
+        uint64_t m_elemId;
+        uint64_t m_generation;
+        HWND m_window;
+        std::wstring m_source;                                  // путь к файлу или ключ данных в памяти
+        std::shared_ptr<const std::vector<uint8_t>> m_data;     // данные в памяти (nullptr - файл)
+        UINT m_boxWidth, m_boxHeight;                           // 0 - естественный размер
+    };
+    struct _M_Result {
+        uint64_t m_generation;
+        std::shared_ptr<_M_ImageBitmap> m_bitmap;               // nullptr - ошибка декодирования
+        UINT m_sourceWidth, m_sourceHeight;
+    };
+
+    /**
+     * @brief Найти вариант изображения в кэше (вызывается автоматически)
+     * @param source ключ источника
+     * @param width ширина варианта
+     * @param height высота варианта
+     * @return Вариант (nullptr, если его нет в кэше)
+     */
+    static std::shared_ptr<_M_ImageBitmap> _m_find(const std::wstring &source, UINT width, UINT height);
+    /**
+     * @brief Поставить загрузку в очередь фонового потока (вызывается автоматически)
+     * @param job задание
+     */
+    static void _m_request(_M_Job job);
+    /**
+     * @brief Забрать результат загрузки для элемента (вызывается автоматически)
+     * @param elemId ИД элемента
+     * @param generation номер запроса элемента (устаревшие результаты отбрасываются)
+     * @param result результат
+     * @return T - результат есть
+     */
+    static bool _m_take(uint64_t elemId, uint64_t generation, _M_Result &result);
+    /**
+     * @brief Отменить загрузки элемента (вызывается автоматически при удалении элемента)
+     * @param elemId ИД элемента
+     */
+    static void _m_cancel(uint64_t elemId);
+    /**
+     * @brief Остановить фоновый поток (вызывается автоматически при выходе из цикла сообщений)
+     */
+    static void _m_shutdown();
+
+protected:
+    // Очередь загрузок, результаты и записи LRU (определены в реализации вместе с фоновым потоком)
+    struct _M_Entry;
+    struct _M_State;
+
+    static _M_State &s_state();
+
+    static std::wstring s_key(const std::wstring &source, UINT width, UINT height) {
+        return source + L'|' + std::to_wstring(width) + L'x' + std::to_wstring(height);
+    }
+
+    // Размер варианта: исходник, вписанный в область элемента с сохранением пропорций
+    static void s_fit(UINT sourceWidth, UINT sourceHeight, UINT boxWidth, UINT boxHeight, UINT &width, UINT &height) {
+        if (!boxWidth || !boxHeight || !sourceWidth || !sourceHeight) {
+            width = sourceWidth;
+            height = sourceHeight;
+            return;
+        }
+        double scale = std::min((double)boxWidth / sourceWidth, (double)boxHeight / sourceHeight);
+        width = std::max<UINT>(1, (UINT)(sourceWidth * scale + 0.5));
+        height = std::max<UINT>(1, (UINT)(sourceHeight * scale + 0.5));
+    }
+
+    static void s_work();
+};
+
+
+/**
+ * @brief Класс изображения (BMP, PNG, JPEG и другие форматы WIC)
+ * @details Изображение загружается в фоновом потоке и вписывается в размер элемента с сохранением пропорций.
+ *          Декодированные изображения хранятся в общем кэше (см. ImageCache)
+ */
+class Image : public IElement, public IPositionElement, public ISizeElement, public IOwnerDrawElement {
+public:
+    /**
+     * @brief Конструктор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по изображению)
+     * @param height высота (AutoSize - по изображению)
+     * @param path путь к файлу изображения = ""
+     */
+    Image(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &path = L"") :
+        IElement(_M_EZW32_ELEM_NAME_IMAGE),
+        IPositionElement(posX, posY),
+        ISizeElement(width, height),
+        m_isAutoSize(width == AutoSize || height == AutoSize),
+        m_source(path),
+        m_generation(0),
+        m_sourceWidth(0), m_sourceHeight(0),
+        m_requestedBox({ 0, 0 }),
+        m_requestedGeneration(UINT64_MAX),
+        m_memory(NULL)
+        { }
+
+    ~Image() override {
+        ImageCache::_m_cancel(m_id);
+        if (m_memory)
+            DeleteDC(m_memory);
+    }
+
+    /**
+     * @brief Загрузить изображение из файла
+     * @param path путь к файлу
+     */
+    void load(const std::wstring &path) {
+        m_source = path;
+        m_data = nullptr;
+        m_reset();
+    }
+    /**
+     * @brief Загрузить изображение из памяти (данные копируются)
+     * @param data указатель на содержимое файла изображения
+     * @param size размер данных в байтах
+     */
+    void load(const void *data, size_t size) {
+        auto copy = std::make_shared<std::vector<uint8_t>>((const uint8_t *)data, (const uint8_t *)data + size);
+        // Одинаковые данные получают одинаковый ключ и разделяют запись кэша (FNV-1a)
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (uint8_t byte : *copy)
+            hash = (hash ^ byte) * 0x100000001B3ull;
+        wchar_t key[48];
+        swprintf(key, 48, L"mem:%016llx:%zu", (unsigned long long)hash, size);
+        m_source = key;
+        m_data = std::move(copy);
+        m_reset();
+    }
+    /**
+     * @brief Загружено ли изображение
+     * @return T/F
+     */
+    const bool isLoaded() const { return m_bitmap != nullptr; }
+    /**
+     * @brief Получить исходный размер изображения
+     * @return размер (0, 0 - ещё не загружено)
+     */
+    const COORD getImageSize() const { return { (SHORT)m_sourceWidth, (SHORT)m_sourceHeight }; }
+
+    /**
+     * @brief Инициализирует дескриптор и запускает загрузку
+     * @param parent дескриптор родительского элемента
+     */
+    void create(HWND parent) override {
+        if (m_size.X == AutoSize || m_size.Y == AutoSize)
+            m_size = { 0, 0 };
+        m_handle = CreateWindow(
+            m_className,
+            NULL,
+            WS_CHILD | WS_VISIBLE | SS_OWNERDRAW,
+            m_pos.X, m_pos.Y,
+            m_size.X, m_size.Y,
+            parent, (HMENU)m_id,
+            NULL,
+            NULL
+        );
+        m_requestedGeneration = UINT64_MAX;
+        m_request(m_boxWidth(), m_boxHeight());
+    }
+
+    /**
+     * @brief Нарисовать изображение (вызывается автоматически)
+     * @param draw параметры рисования
+     */
+    void _m_drawItem(const DRAWITEMSTRUCT &draw) override {
+        UINT boxWidth = (UINT)std::max<LONG>(draw.rcItem.right - draw.rcItem.left, 0);
+        UINT boxHeight = (UINT)std::max<LONG>(draw.rcItem.bottom - draw.rcItem.top, 0);
+        FillRect(draw.hDC, &draw.rcItem, GetSysColorBrush(COLOR_WINDOW));
+        if (!m_bitmap)
+            return;
+
+        UINT width, height;
+        ImageCache::s_fit(m_sourceWidth, m_sourceHeight, m_isAutoSize ? 0 : boxWidth, m_isAutoSize ? 0 : boxHeight, width, height);
+        if (width != m_bitmap->m_width || height != m_bitmap->m_height) {
+            if (auto variant = ImageCache::_m_find(m_source, width, height))
+                m_bitmap = std::move(variant);
+            else
+                m_request(m_isAutoSize ? 0 : boxWidth, m_isAutoSize ? 0 : boxHeight);
+        }
+        // Пока нужного варианта нет, растягивается имеющийся. Вариант из кэша может быть выбран и в DC другого Image,
+        // а кэш удаляет вытесненные варианты, поэтому битмап выбирается только на время рисования
+        if (!m_memory)
+            m_memory = CreateCompatibleDC(draw.hDC);
+        HGDIOBJ old = SelectObject(m_memory, m_bitmap->m_bitmap);
+        BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+        AlphaBlend(
+            draw.hDC,
+            draw.rcItem.left + ((int)boxWidth - (int)width) / 2, draw.rcItem.top + ((int)boxHeight - (int)height) / 2,
+            (int)width, (int)height,
+            m_memory, 0, 0, (int)m_bitmap->m_width, (int)m_bitmap->m_height,
+            blend
+        );
+        SelectObject(m_memory, old);
+    }
+    /**
+     * @brief Обработать изменение размера по привязке (вызывается автоматически)
+     */
+    void _m_onResized() override {
+        // Изображение центрируется заново, поэтому перерисовывается целиком, а не только открывшаяся часть
+        InvalidateRect(m_handle, NULL, FALSE);
+    }
+    /**
+     * @brief Применить загруженное изображение (вызывается автоматически)
+     */
+    void _m_onLoaded() {
+        ImageCache::_M_Result result;
+        if (!ImageCache::_m_take(m_id, m_generation, result) || !result.m_bitmap)
+            return;
+        m_bitmap = std::move(result.m_bitmap);
+        m_sourceWidth = result.m_sourceWidth;
+        m_sourceHeight = result.m_sourceHeight;
+        if (m_isAutoSize && (m_size.X != (SHORT)m_bitmap->m_width || m_size.Y != (SHORT)m_bitmap->m_height)) {
+            m_size = { (SHORT)m_bitmap->m_width, (SHORT)m_bitmap->m_height };
+            SetWindowPos(m_handle, NULL, 0, 0, m_size.X, m_size.Y, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+        InvalidateRect(m_handle, NULL, FALSE);
+    }
+
+protected:
+    bool m_isAutoSize;
+    std::wstring m_source;
+    std::shared_ptr<const std::vector<uint8_t>> m_data;
+    std::shared_ptr<_M_ImageBitmap> m_bitmap;
+    uint64_t m_generation;
+    UINT m_sourceWidth, m_sourceHeight;
+    COORD m_requestedBox;
+    uint64_t m_requestedGeneration;
+    HDC m_memory;                   // DC для вывода битмапа, создаётся при первом рисовании
+
+    UINT m_boxWidth() const { return m_isAutoSize ? 0 : (UINT)std::max<SHORT>(m_size.X, 0); }
+    UINT m_boxHeight() const { return m_isAutoSize ? 0 : (UINT)std::max<SHORT>(m_size.Y, 0); }
+
+    void m_reset() {
+        m_generation++;
+        m_bitmap = nullptr;
+        m_sourceWidth = m_sourceHeight = 0;
+        if (!m_handle)
+            return;
+        InvalidateRect(m_handle, NULL, FALSE);
+        m_request(m_boxWidth(), m_boxHeight());
+    }
+    void m_request(UINT boxWidth, UINT boxHeight) {
+        if (m_source.empty() || !m_handle)
+            return;
+        // Повторный запрос того же размера не ставится в очередь, пока не придёт результат
+        if (m_requestedBox.X == (SHORT)boxWidth && m_requestedBox.Y == (SHORT)boxHeight && m_generation == m_requestedGeneration)
+            return;
+        m_requestedBox = { (SHORT)boxWidth, (SHORT)boxHeight };
+        m_requestedGeneration = m_generation;
+        ImageCache::_m_request({ m_id, m_generation, GetParent(m_handle), m_source, m_data, boxWidth, boxHeight });
+    }
+};
+
+// Фоновый поток загрузки дочерних узлов TreeView (определён в реализации)
+struct _M_TreeLoader;
+
+/**
+ * @brief Дочерний узел, возвращаемый функцией загрузки TreeView
+ */
+struct TreeItem {
+    std::wstring text;
+    uint64_t key;           // ключ узла, по которому загружаются его дочерние узлы
+    bool hasChildren;       // F - узел нельзя раскрыть
+};
+
+/**
+ * @brief Запрос дочерних узлов, передаваемый функции загрузки TreeView
+ */
+struct TreeLoad {
+    const uint64_t key;                 // ключ раскрываемого узла
+    std::vector<TreeItem> children;     // дочерние узлы в порядке показа (заполняет функция загрузки)
+
+    /**
+     * @brief Добавить дочерний узел
+     * @param text текст узла
+     * @param childKey ключ узла
+     * @param hasChildren можно ли раскрыть узел = F
+     */
+    void add(std::wstring text, uint64_t childKey, bool hasChildren = false) {
+        children.push_back({ std::move(text), childKey, hasChildren });
+    }
+    /**
+     * @brief Отменён ли запрос (дерево сброшено или удалено); долгую загрузку можно прервать
+     * @return T/F
+     */
+    bool isCancelled() const { return m_epoch != m_current->load(std::memory_order_relaxed); }
+
+protected:
+    friend struct _M_TreeLoader;
+
+    TreeLoad(uint64_t key, uint64_t epoch, const std::atomic<uint64_t> *current) :
+        key(key),
+        m_epoch(epoch),
+        m_current(current)
+        { }
+
+    const uint64_t m_epoch;
+    const std::atomic<uint64_t> *m_current;
+};
+
+/**
+ * @brief Устойчивый дескриптор узла TreeView
+ * @details Выгруженный узел освобождается, и его дескриптор перестаёт быть действительным (см. TreeView::isAlive),
+ *          даже если место узла занято другим
+ */
+struct TreeNode {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    /**
+     * @brief Пуст ли дескриптор
+     * @return T/F
+     */
+    bool isNull() const { return index == UINT32_MAX; }
+    friend bool operator ==(const TreeNode &, const TreeNode &) = default;
+};
+
+/**
+ * @brief Класс дерева с загрузкой дочерних узлов по требованию
+ * @details Дочерние узлы запрашиваются у функции загрузки в фоновом потоке при первом раскрытии узла и передаются
+ *          дереву пачками по таймеру, поэтому раскрытие узла с сотнями тысяч дочерних не блокирует окно. Текст узлов хранится
+ *          только в дереве элемента (LPSTR_TEXTCALLBACK). Когда загружено больше узлов, чем позволяет бюджет
+ *          (см. setNodeBudget), выгружаются поддеревья, свёрнутые раньше всех
+ */
+class TreeView : public IElement, public IPositionElement, public ISizeElement {
+public:
+    /**
+     * @brief Число узлов, вставляемых в дерево за один шаг (следующие пачки - по таймеру)
+     */
+    static constexpr size_t s_batchSize = 2048;
+
+    /**
+     * @brief Конструктор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param onLoad функция загрузки дочерних узлов (вызывается в фоновом потоке) = NULL
+     * @param rootKey ключ невидимого корня, дочерние узлы которого - узлы верхнего уровня = 0
+     */
+    TreeView(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<TreeLoad> onLoad = nullptr, uint64_t rootKey = 0) :
+        IElement(_M_EZW32_ELEM_NAME_TREEVIEW),
+        IPositionElement(posX, posY),
+        ISizeElement(width, height),
+        m_onLoad(std::move(onLoad)),
+        m_nodes(1),
+        m_nodeCount(0),
+        m_nodeBudget(1 << 20),
+        m_collapseStamp(0)
+        {
+            m_nodes[0].m_key = rootKey;
+            m_nodes[0].m_hasChildren = true;
+        }
+
+    /**
+     * @brief Инициализирует дескриптор и запускает загрузку узлов верхнего уровня
+     * @param parent дескриптор родительского элемента
+     */
+    void create(HWND parent) override;
+
+    /**
+     * @brief Установить функцию загрузки дочерних узлов
+     * @param onLoad функция загрузки; вызывается в фоновом потоке и не должна обращаться к элементам окна
+     * @warning Вызывать до открытия окна
+     */
+    void setOnLoad(Callback<TreeLoad> onLoad) { m_onLoad = std::move(onLoad); }
+    /**
+     * @brief Получить ответную функцию
+     * @return ответная функция
+     */
+    const Callback<TreeView> &getOnSelect() const { return m_onSelect; }
+    /**
+     * @brief Установить ответную функцию на выбор узла
+     * @param onSelect ответная функция
+     */
+    void setOnSelect(Callback<TreeView> onSelect) { m_onSelect = std::move(onSelect); }
+
+    /**
+     * @brief Установить бюджет загруженных узлов (по умолчанию 1048576)
+     * @details Раскрытые поддеревья не выгружаются, поэтому бюджет может быть превышен
+     * @param nodes число узлов
+     */
+    void setNodeBudget(size_t nodes) {
+        m_nodeBudget = nodes;
+        m_requestUpdate();
+    }
+    /**
+     * @brief Получить бюджет загруженных узлов
+     * @return число узлов
+     */
+    const size_t getNodeBudget() const { return m_nodeBudget; }
+    /**
+     * @brief Получить число загруженных узлов
+     * @return число узлов
+     */
+    const size_t getNodeCount() const { return m_nodeCount; }
+
+    /**
+     * @brief Действителен ли дескриптор узла (узел не выгружен)
+     * @param node дескриптор узла
+     * @return T/F
+     */
+    bool isAlive(TreeNode node) const {
+        return node.index != 0 && node.index < m_nodes.size() && m_nodes[node.index].m_generation == node.generation && !m_nodes[node.index].m_isFree;
+    }
+    /**
+     * @brief Получить выделенный узел
+     * @return Дескриптор узла (пустой, если ни один узел не выбран)
+     */
+    TreeNode getSelected() const { return isAlive(m_selected) ? m_selected : TreeNode(); }
+    /**
+     * @brief Получить текст узла
+     * @param node дескриптор узла
+     * @return Текст (действителен до следующей загрузки или выгрузки узлов)
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    std::wstring_view getText(TreeNode node) const { return m_textOf(m_node(node, "Node has been unloaded (easywindows32::TreeView::getText)")); }
+    /**
+     * @brief Получить ключ узла
+     * @param node дескриптор узла
+     * @return Ключ
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    uint64_t getKey(TreeNode node) const { return m_node(node, "Node has been unloaded (easywindows32::TreeView::getKey)").m_key; }
+    /**
+     * @brief Получить родительский узел
+     * @param node дескриптор узла
+     * @return Дескриптор родителя (пустой у узлов верхнего уровня)
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    TreeNode getParent(TreeNode node) const {
+        uint32_t parent = m_node(node, "Node has been unloaded (easywindows32::TreeView::getParent)").m_parent;
+        return parent ? m_handleOf(parent) : TreeNode();
+    }
+    /**
+     * @brief Загружены ли дочерние узлы
+     * @param node дескриптор узла
+     * @return T/F
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    bool isLoaded(TreeNode node) const { return m_node(node, "Node has been unloaded (easywindows32::TreeView::isLoaded)").m_state == _M_State::Loaded; }
+    /**
+     * @brief Идёт ли загрузка каких-либо узлов
+     * @return T/F
+     */
+    bool isLoading() const { return m_loadingCount != 0; }
+
+    /**
+     * @brief Раскрыть узел (дочерние узлы загружаются, если ещё не загружены)
+     * @param node дескриптор узла
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    void expand(TreeNode node);
+    /**
+     * @brief Свернуть узел
+     * @param node дескриптор узла
+     * @throws Если узел выгружен (easywindows32::Exception)
+     */
+    void collapse(TreeNode node);
+    /**
+     * @brief Выгрузить все узлы и заново загрузить узлы верхнего уровня
+     */
+    void reset();
+
+    /**
+     * @brief Обработать уведомление дерева (вызывается автоматически)
+     * @param header заголовок уведомления (NMHDR)
+     * @return Результат обработки уведомления
+     */
+    LRESULT _m_notify(const NMHDR &header);
+    /**
+     * @brief Вставить в дерево готовые узлы и выгрузить лишние (вызывается автоматически)
+     */
+    void _m_onUpdate();
+
+protected:
+    enum class _M_State : uint8_t { NotLoaded, Loading, Loaded };
+
+    static constexpr size_t s_maxTextLength = (1 << 24) - 1;
+
+    // Узел арены; связи - индексы в m_nodes, UINT32_MAX - нет узла. Узел 0 - невидимый корень.
+    // Текст лежит в общем массиве m_textPool (с завершающим нулём), поэтому узел не выделяет память сам
+    struct _M_Node {
+        uint64_t m_textOffset : 40 = 0;
+        uint64_t m_textLength : 24 = 0;
+        uint64_t m_key = 0;
+        void *m_item = nullptr;                 // HTREEITEM
+        uint32_t m_parent = UINT32_MAX;
+        uint32_t m_firstChild = UINT32_MAX;
+        uint32_t m_nextSibling = UINT32_MAX;
+        uint32_t m_generation = 0;
+        uint32_t m_collapseStamp = 0;           // номер последнего сворачивания (см. m_collapsed)
+        _M_State m_state = _M_State::NotLoaded;
+        bool m_hasChildren = false;
+        bool m_isExpanded = false;
+        bool m_isFree = false;
+    };
+
+    Callback<TreeLoad> m_onLoad;
+    Callback<TreeView> m_onSelect;
+    std::vector<_M_Node> m_nodes;
+    std::vector<uint32_t> m_freeNodes;
+    std::vector<wchar_t> m_textPool;
+    size_t m_textGarbage = 0;               // символы освобождённых узлов, которые ещё занимают место в m_textPool
+    size_t m_nodeCount;
+    size_t m_nodeBudget;
+    size_t m_loadingCount = 0;
+    TreeNode m_selected;
+    // Свёрнутые загруженные узлы в порядке сворачивания - кандидаты на выгрузку; записи до m_collapsedHead уже разобраны
+    std::vector<std::pair<uint32_t, uint32_t>> m_collapsed;
+    size_t m_collapsedHead = 0;
+    uint32_t m_collapseStamp;
+    _M_Hidden<_M_TreeLoader> m_loader;
+
+    TreeNode m_handleOf(uint32_t index) const { return { index, m_nodes[index].m_generation }; }
+
+    std::wstring_view m_textOf(const _M_Node &node) const {
+        return std::wstring_view(m_textPool.data() + node.m_textOffset, node.m_textLength);
+    }
+    // Слишком длинный текст обрезается: дерево всё равно показывает только начало строки
+    void m_setText(_M_Node &node, std::wstring_view text) {
+        text = text.substr(0, s_maxTextLength);
+        node.m_textOffset = m_textPool.size();
+        node.m_textLength = text.size();
+        m_textPool.insert(m_textPool.end(), text.begin(), text.end());
+        m_textPool.push_back(L'\0');
+    }
+    // Заново укладывает текст живых узлов, когда больше половины m_textPool занято освобождёнными
+    void m_compactText() {
+        if (m_textGarbage <= m_textPool.size() / 2)
+            return;
+        std::vector<wchar_t> pool;
+        pool.swap(m_textPool);
+        m_textPool.reserve(pool.size() - m_textGarbage);
+        m_textGarbage = 0;
+        for (size_t i = 1; i < m_nodes.size(); i++)
+            if (!m_nodes[i].m_isFree)
+                m_setText(m_nodes[i], std::wstring_view(pool.data() + m_nodes[i].m_textOffset, m_nodes[i].m_textLength));
+    }
+
+    const _M_Node &m_node(TreeNode node, const char *message) const {
+        if (!isAlive(node))
+            throw Exception(message);
+        return m_nodes[node.index];
+    }
+
+    uint32_t m_allocNode() {
+        m_nodeCount++;
+        if (!m_freeNodes.empty()) {
+            uint32_t index = m_freeNodes.back();
+            m_freeNodes.pop_back();
+            m_nodes[index].m_isFree = false;
+            return index;
+        }
+        if (m_nodes.size() >= UINT32_MAX)
+            throw Exception("Too many nodes (easywindows32::TreeView)");
+        m_nodes.emplace_back();
+        return (uint32_t)(m_nodes.size() - 1);
+    }
+    // Освобождает узел и всё его поддерево; дескрипторы освобождённых узлов становятся недействительными
+    void m_freeChildren(uint32_t index) {
+        std::vector<uint32_t> stack;
+        for (uint32_t child = m_nodes[index].m_firstChild; child != UINT32_MAX; child = m_nodes[child].m_nextSibling)
+            stack.push_back(child);
+        while (!stack.empty()) {
+            uint32_t current = stack.back();
+            stack.pop_back();
+            _M_Node &node = m_nodes[current];
+            for (uint32_t child = node.m_firstChild; child != UINT32_MAX; child = m_nodes[child].m_nextSibling)
+                stack.push_back(child);
+            uint32_t generation = node.m_generation + 1;
+            m_textGarbage += node.m_textLength + 1;
+            node = _M_Node();
+            node.m_generation = generation;
+            node.m_isFree = true;
+            m_freeNodes.push_back(current);
+            m_nodeCount--;
+        }
+        _M_Node &node = m_nodes[index];
+        node.m_firstChild = UINT32_MAX;
+        node.m_state = _M_State::NotLoaded;
+        node.m_isExpanded = false;
+        m_compactText();
+    }
+
+    void m_request(uint32_t index);
+    void m_requestUpdate() {
+        if (m_handle)
+            PostMessage(GetParent(m_handle), _M_EZW32_WM_TREE_UPDATE, (WPARAM)m_id, (LPARAM)NULL);
+    }
+    void m_onCollapsed(uint32_t index) {
+        _M_Node &node = m_nodes[index];
+        node.m_isExpanded = false;
+        if (node.m_state != _M_State::Loaded)
+            return;
+        node.m_collapseStamp = ++m_collapseStamp;
+        m_collapsed.push_back({ index, node.m_collapseStamp });
+        // Пока бюджет не превышен, очередь не разбирается, поэтому устаревшие записи удаляются, когда их становится
+        // больше, чем загруженных узлов (действительных записей не больше числа узлов)
+        if (m_collapsed.size() - m_collapsedHead > 2 * m_nodeCount + 64) {
+            m_collapsed.erase(m_collapsed.begin(), m_collapsed.begin() + m_collapsedHead);
+            m_collapsedHead = 0;
+            std::erase_if(m_collapsed, [this](const std::pair<uint32_t, uint32_t> &entry) { return !m_isCandidate(entry.first, entry.second); });
+        }
+        if (m_nodeCount > m_nodeBudget)
+            m_requestUpdate();
+    }
+    bool m_isCandidate(uint32_t index, uint32_t stamp) const {
+        const _M_Node &node = m_nodes[index];
+        return !node.m_isFree && node.m_collapseStamp == stamp && !node.m_isExpanded && node.m_state == _M_State::Loaded;
+    }
+    // Узлы выгружаются в порядке сворачивания; узел, раскрытый или свёрнутый заново после записи, пропускается
+    void m_trim() {
+        while (m_nodeCount > m_nodeBudget && m_collapsedHead < m_collapsed.size()) {
+            auto [index, stamp] = m_collapsed[m_collapsedHead++];
+            if (m_isCandidate(index, stamp))
+                m_unload(index);
+        }
+        // Разобранное начало очереди сдвигается, когда занимает больше половины
+        if (m_collapsedHead > m_collapsed.size() / 2) {
+            m_collapsed.erase(m_collapsed.begin(), m_collapsed.begin() + m_collapsedHead);
+            m_collapsedHead = 0;
+        }
+    }
+    void m_expandItem(uint32_t index);
+    void m_unload(uint32_t index);
+
+    void m_deliverEvent() override {
+        if (m_onSelect)
+            m_onSelect(*this);
+    }
+};
+
+
+/**
+ * @brief Класс-обёртка ссылки на объект
+ * @tparam T тип объекта
+ */
+template <class T>
+class Reference {
+public:
+    /**
+     * @brief Конструктор по умолчанию
+     */
+    Reference() : m_ptr(nullptr) { };
+    /**
+     * @brief Конструктор
+     * @param ref lvalue-ссылка на объект
+     */
+    Reference(T &ref) : m_ptr(&ref) { };
+    /**
+     * @brief Конструктор
+     * @param ref rvalue-ссылка на объект
+     */
+    Reference(T &&ref) : m_ptr(&ref) { };
+    /**
+     * @brief Конструктор
+     * @param ref lvalue-ссылка на другую ссылку
+     */
+    Reference(const Reference<T> &ref) : m_ptr(ref->m_ptr) { };
+    /**
+     * @brief Конструктор
+     * @param ref rvalue-ссылка на другую ссылку
+     */
+    Reference(Reference<T> &&ref) : m_ptr(ref->m_ptr) { };
+    
+    /**
+     * @brief Установка значения
+     * @param ref lvalue-ссылка на объект
+     */
+    Reference &operator =(T &ref) { m_ptr = &ref; return *this; }
+    /**
+     * @brief Установка значения
+     * @param ref rvalue-ссылка на объект
+     */
+    Reference &operator =(T &&ref) { m_ptr = &ref; return *this; }
+    /**
+     * @brief Установка значения
+     * @param ref lvalue-ссылка на другую ссылку
+     */
+    Reference &operator =(const Reference &ref) { m_ptr = ref.m_ptr; return *this; }
+    /**
+     * @brief Установка значения
+     * @param ref rvalue-ссылка на другую ссылку
+     */
+    Reference &operator =(Reference &&ref) { m_ptr = ref.m_ptr; return *this; }
+    /**
+     * @brief Обращение к объекту
+     * @return указатель на объект
+     */
+    T *operator ->() { return m_ptr; }
+
+    /**
+     * @brief Получение объекта
+     * @return ссылка на объект
+     */
+    T &get() { return *m_ptr; }
+
+    /**
+     * @brief Хранит ли объект ссылку?
+     * @return T - объект ссылки пуст, F - имеет объект
+     */
+    bool isnull() const { return (m_ptr == nullptr); }
+
+    /**
+     * @brief Проверка равенства ссылок
+     * @param ref1 ссылка А
+     * @param ref2 ссылка на объект Б
+     * @return T/F
+     */
+    friend bool operator ==(const Reference &ref1, const T &ref2) { return (ref1.m_ptr == &ref2); }
+    /**
+     * @brief Проверка равенства ссылок
+     * @param ref1 ссылка А
+     * @param ref2 ссылка Б
+     * @return T/F
+     */
+    friend bool operator ==(const Reference &ref1, const Reference &ref2) { return (ref1.m_ptr == ref2.m_ptr); }
+
+protected:
+    T *m_ptr;
+};
+
+/**
+ * @brief Ссылка на Static
+ */
+using RStatic = Reference<Static>;
+/**
+ * @brief Ссылка на Button
+ */
+using RButton = Reference<Button>;
+/**
+ * @brief Ссылка на Edit
+ */
+using REdit = Reference<Edit>;
+/**
+ * @brief Ссылка на NumericEdit
+ */
+template <NumericValue T>
+using RNumericEdit = Reference<NumericEdit<T>>;
+/**
+ * @brief Ссылка на ListBox
+ */
+using RListBox = Reference<ListBox>;
+/**
+ * @brief Ссылка на ProgressBar
+ */
+using RProgressBar = Reference<ProgressBar>;
+/**
+ * @brief Ссылка на Meter
+ */
+using RMeter = Reference<Meter>;
+/**
+ * @brief Ссылка на Image
+ */
+using RImage = Reference<Image>;
+/**
+ * @brief Ссылка на TreeView
+ */
+using RTreeView = Reference<TreeView>;
+
+
+struct _M_ResizeLayout {
+    struct _M_Entry {
+        IElement *m_elem;
+        IPositionElement *m_posElem;
+        ISizeElement *m_sizeElem;
+        IOwnerDrawElement *m_ownerDraw;    // nullptr, если элемент рисует не сам
+        Anchor m_anchor;
+        LayoutRect m_base;                 // прямоугольник при размере окна m_baseWidth x m_baseHeight
+        LONG m_baseWidth, m_baseHeight;
+        bool m_dependsX, m_dependsY;
+    };
+
+    std::vector<_M_Entry> m_entries;
+    LONG m_width = 0, m_height = 0;
+    std::atomic<uint64_t> m_anchorVersion = 0;   // увеличивается IElement::setAnchor у элементов этого окна
+    uint64_t m_builtVersion = 0;
+
+    // Запоминает исходные прямоугольники; элементы с привязкой Left|Top никогда не двигаются и в таблицу не попадают
+    void build(HWND hWnd, const std::vector<IElement *> &elements) {
+        RECT client;
+        GetClientRect(hWnd, &client);
+        m_width = client.right - client.left;
+        m_height = client.bottom - client.top;
+        m_builtVersion = m_anchorVersion;
+        m_entries.clear();
+        for (IElement *elem : elements)
+            m_addEntry(m_entries, elem);
+    }
+
+    // Пересчитывает только элементы, зависящие от изменившегося измерения, и применяет изменения одним DeferWindowPos
+    void resize(const std::vector<IElement *> &elements, LONG width, LONG height) {
+        if (m_builtVersion != m_anchorVersion) {
+            m_builtVersion = m_anchorVersion;
+            m_rebuild(elements);
+        }
+
+        bool changedX = (width != m_width);
+        bool changedY = (height != m_height);
+        m_width = width;
+        m_height = height;
+        if (!changedX && !changedY)
+            return;
+
+        static thread_local std::vector<std::tuple<_M_Entry *, LayoutRect, bool>> s_moved;
+        s_moved.clear();
+        for (_M_Entry &entry : m_entries) {
+            if (!(changedX && entry.m_dependsX) && !(changedY && entry.m_dependsY))
+                continue;
+            LayoutRect rect = entry.m_base;
+            s_applyAxis(entry.m_anchor, Anchor::Left, Anchor::Right, width - entry.m_baseWidth, rect.x, rect.width);
+            s_applyAxis(entry.m_anchor, Anchor::Top, Anchor::Bottom, height - entry.m_baseHeight, rect.y, rect.height);
+            COORD &pos = entry.m_posElem->m_pos;
+            COORD &size = entry.m_sizeElem->m_size;
+            bool isResized = (size.X != rect.width || size.Y != rect.height);
+            if (pos.X == rect.x && pos.Y == rect.y && !isResized)
+                continue;
+            pos = { rect.x, rect.y };
+            size = { rect.width, rect.height };
+            s_moved.emplace_back(&entry, rect, isResized);
+        }
+        if (s_moved.empty())
+            return;
+
+        HDWP hdwp = BeginDeferWindowPos((int)s_moved.size());
+        for (auto &[entry, rect, isResized] : s_moved) {
+            if (!hdwp)
+                break;
+            hdwp = DeferWindowPos(
+                hdwp, entry->m_elem->m_handle, NULL,
+                rect.x, rect.y, rect.width, rect.height,
+                SWP_NOZORDER | SWP_NOOWNERZORDER | SWP_NOACTIVATE
+            );
+        }
+        if (hdwp)
+            EndDeferWindowPos(hdwp);
+        for (auto &[entry, rect, isResized] : s_moved)
+            if (isResized && entry->m_ownerDraw)
+                entry->m_ownerDraw->_m_onResized();
+    }
+
+    // Элементы с прежней привязкой сохраняют свой исходный прямоугольник; остальные получают текущий прямоугольник
+    // при текущем размере окна, поэтому смещение не приходится вычитать обратно
+    void m_rebuild(const std::vector<IElement *> &elements) {
+        std::vector<_M_Entry> entries;
+        entries.reserve(m_entries.size());
+        size_t old = 0;
+        for (IElement *elem : elements) {
+            if (old < m_entries.size() && m_entries[old].m_elem == elem) {
+                if (m_entries[old].m_anchor == elem->m_anchor) {
+                    entries.push_back(m_entries[old++]);
+                    continue;
+                }
+                old++;
+            }
+            m_addEntry(entries, elem);
+        }
+        m_entries = std::move(entries);
+    }
+
+    void m_addEntry(std::vector<_M_Entry> &entries, IElement *elem) {
+        Anchor anchor = elem->m_anchor;
+        bool dependsX = !(hasAnchor(anchor, Anchor::Left) && !hasAnchor(anchor, Anchor::Right));
+        bool dependsY = !(hasAnchor(anchor, Anchor::Top) && !hasAnchor(anchor, Anchor::Bottom));
+        if (!dependsX && !dependsY)
+            return;
+        IPositionElement *posElem = dynamic_cast<IPositionElement *>(elem);
+        ISizeElement *sizeElem = dynamic_cast<ISizeElement *>(elem);
+        if (!posElem || !sizeElem || !elem->m_handle)
+            return;
+        LayoutRect base = { posElem->m_pos.X, posElem->m_pos.Y, sizeElem->m_size.X, sizeElem->m_size.Y };
+        IOwnerDrawElement *ownerDraw = dynamic_cast<IOwnerDrawElement *>(elem);
+        entries.push_back({ elem, posElem, sizeElem, ownerDraw, anchor, base, m_width, m_height, dependsX, dependsY });
+    }
+
+    static void s_applyAxis(Anchor anchor, Anchor nearFlag, Anchor farFlag, LONG delta, SHORT &pos, SHORT &size) {
+        bool isNear = hasAnchor(anchor, nearFlag);
+        bool isFar = hasAnchor(anchor, farFlag);
+        if (isNear && isFar)
+            size = (SHORT)std::max<LONG>(0, size + delta);
+        else if (isFar)
+            pos = (SHORT)(pos + delta);
+        else if (!isNear)
+            pos = (SHORT)(pos + delta / 2);
+    }
+};
+
+enum class RecordedEventType : uint8_t;
+
+inline WPARAM _m_runMessageLoop() {
+    MSG msg = { };
+    while (GetMessage(&msg, NULL, 0, 0) > 0) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+    return msg.wParam;
+}
+
+/**
+ * @brief Окно верхнего уровня со своим набором элементов
+ * @details Окно может работать в собственном потоке со своим циклом сообщений (см. setOwnThread),
+ *          тогда медленные ответные функции одного окна не задерживают остальные
+ */
+class Window {
+public:
+    /**
+     * @brief Конструктор
+     * @param title название окна
+     */
+    Window(LPCWSTR title = L"window title");
+
+    Window(const Window &) = delete;
+    Window &operator =(const Window &) = delete;
+
+    ~Window();
+
+    /**
+     * @brief Получить дескриптор окна
+     * @return дескриптор (NULL, если окно ещё не открыто или уже закрыто)
+     */
+    const HWND getHandle() const { return m_handle; }
+    /**
+     * @brief Является ли окно главным (закрытие главного окна завершает приложение)
+     * @return T/F
+     */
+    const bool isMain() const { return m_isMain; }
+    /**
+     * @brief Получить порядковый номер окна (0 - главное, далее в порядке addWindow)
+     * @return номер окна
+     */
+    const uint32_t getIndex() const { return m_index; }
+    /**
+     * @brief Получить время выполнения последнего обработанного события (ответная функция + служебная работа)
+     * @return время в мкс
+     */
+    const uint64_t getLastHandlerTime() const { return m_lastHandlerTime; }
+
+    /**
+     * @brief Установить положение окна на экране
+     * @param x X-координата
+     * @param y Y-координата
+     */
+    void setPosition(DWORD x, DWORD y) {
+        m_posX = x;
+        m_posY = y;
+    }
+    /**
+     * @brief Установить размер окна
+     * @param width ширина (X-размер)
+     * @param height высота (Y-размер)
+     */
+    void setSize(DWORD width, DWORD height) {
+        m_width = width;
+        m_height = height;
+    }
+    /**
+     * @brief Установить название окна
+     * @param title название
+     */
+    void setTitle(LPCWSTR title) {
+        m_title = title;
+        if (m_handle)
+            SetWindowText(m_handle, m_title);
+    }
+    /**
+     * @brief Установить стиль окна
+     * @param style флаги стилей (DWORD)
+     */
+    void setStyle(DWORD style) { m_style = style; }
+    /**
+     * @brief Установить возможность измены размера окна
+     * @details При изменении размера элементы перемещаются согласно своей привязке (см. IElement::setAnchor)
+     * @param value T/F
+     */
+    void setResizeable(bool value) {
+        m_isResizeable = value;
+        if (m_isResizeable)
+            m_style |= WS_THICKFRAME;
+        else
+            m_style &= ~WS_THICKFRAME;
+    }
+    /**
+     * @brief Запускать ли окно в собственном потоке со своим циклом сообщений (по умолчанию F)
+     * @param value T/F
+     * @warning Ответные функции такого окна вызываются из его потока
+     */
+    void setOwnThread(bool value) { m_isOwnThread = value; }
+    /**
+     * @brief Установить функцию, которая вызывается при закрытии окна
+     * @param onClose ответная функция
+     */
+    void setOnClose(Callback<Window> onClose) { m_onClose = std::move(onClose); }
+    /**
+     * @brief Установить период опроса счётчиков ProgressBar и Meter (по умолчанию 33 мс - около 30 раз в секунду)
+     * @param interval период в мс
+     */
+    void setSampleInterval(UINT interval) {
+        m_sampleInterval = std::max<UINT>(interval, USER_TIMER_MINIMUM);
+        if (m_handle && !m_sampled.empty())
+            SetTimer(m_handle, _M_EZW32_SAMPLE_TIMER_ID, m_sampleInterval, NULL);
+    }
+
+    /**
+     * @brief Добавить статичный текстовый элемент
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
+     * @param text текст = ""
+     * @param alignText выравнивание = Center
+     * @return Ссылка на добавленный статичный текстовый элемент
+     */
+    Static &addStatic(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Align alignText = Align::Center) {
+        return m_add(new Static(posX, posY, width, height, text, alignText));
+    }
+    /**
+     * @brief Добавить статичный текстовый элемент
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param text текст = ""
+     * @param alignText выравнивание = Center
+     * @return Ссылка на добавленный статичный текстовый элемент
+     */
+    Static &addStatic(const LayoutRect &rect, const std::wstring &text = L"", Align alignText = Align::Center) {
+        return addStatic(rect.x, rect.y, rect.width, rect.height, text, alignText);
+    }
+    /**
+     * @brief Добавить кнопку
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
+     * @param text текст = ""
+     * @param onClick ответная функция на нажатие = NULL
+     * @param alignText выравнивание = Center
+     * @param delivery политика доставки нажатий = immediate
+     * @return Ссылка на добавленную кнопку
+     */
+    Button &addButton(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Callback<Button> onClick = nullptr, Align alignText = Align::Center, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+        Button &newBtn = m_add(new Button(posX, posY, width, height, text, std::move(onClick), alignText));
+        newBtn.setDeliveryPolicy(delivery);
+        return newBtn;
+    }
+    /**
+     * @brief Добавить кнопку
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param text текст = ""
+     * @param onClick ответная функция на нажатие = NULL
+     * @param alignText выравнивание = Center
+     * @param delivery политика доставки нажатий = immediate
+     * @return Ссылка на добавленную кнопку
+     */
+    Button &addButton(const LayoutRect &rect, const std::wstring &text = L"", Callback<Button> onClick = nullptr, Align alignText = Align::Center, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+        return addButton(rect.x, rect.y, rect.width, rect.height, text, std::move(onClick), alignText, delivery);
+    }
+    /**
+     * @brief Добавить элемент текстового ввода
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
+     * @param isNumberOnly только численный ввод (T/F) = F
+     * @param alignText выравнивание текста = Left
+     * @param presetText начальный текст = ""
+     * @return Ссылка на добавленный элемент текстового ввода
+     */
+    Edit &addEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, bool isNumberOnly = false, Align alignText = Align::Left, const std::wstring &presetText = L"") {
+        return m_add(new Edit(posX, posY, width, height, isNumberOnly, alignText, presetText));
+    }
+    /**
+     * @brief Добавить элемент текстового ввода
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param isNumberOnly только численный ввод (T/F) = F
+     * @param alignText выравнивание текста = Left
+     * @param presetText начальный текст = ""
+     * @return Ссылка на добавленный элемент текстового ввода
+     */
+    Edit &addEdit(const LayoutRect &rect, bool isNumberOnly = false, Align alignText = Align::Left, const std::wstring &presetText = L"") {
+        return addEdit(rect.x, rect.y, rect.width, rect.height, isNumberOnly, alignText, presetText);
+    }
+    /**
+     * @brief Добавить поле ввода числа
+     * @tparam T тип значения
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по тексту)
+     * @param height высота (AutoSize - по тексту)
+     * @param minimum минимальное значение = наименьшее значение T
+     * @param maximum максимальное значение = наибольшее значение T
+     * @param value начальное значение = 0
+     * @param alignText выравнивание текста = Right
+     * @return Ссылка на добавленное поле ввода числа
+     */
+    template <NumericValue T>
+    NumericEdit<T> &addNumericEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, T minimum = std::numeric_limits<T>::lowest(), T maximum = std::numeric_limits<T>::max(), T value = T(), Align alignText = Align::Right) {
+        return m_add(new NumericEdit<T>(posX, posY, width, height, minimum, maximum, value, alignText));
+    }
+    /**
+     * @brief Добавить поле ввода числа
+     * @tparam T тип значения
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param minimum минимальное значение = наименьшее значение T
+     * @param maximum максимальное значение = наибольшее значение T
+     * @param value начальное значение = 0
+     * @param alignText выравнивание текста = Right
+     * @return Ссылка на добавленное поле ввода числа
+     */
+    template <NumericValue T>
+    NumericEdit<T> &addNumericEdit(const LayoutRect &rect, T minimum = std::numeric_limits<T>::lowest(), T maximum = std::numeric_limits<T>::max(), T value = T(), Align alignText = Align::Right) {
+        return addNumericEdit<T>(rect.x, rect.y, rect.width, rect.height, minimum, maximum, value, alignText);
+    }
+    /**
+     * @brief Добавить элемент списка
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param onSelect ответная функция на выбор элемента = NULL
+     * @param delivery политика доставки выбора = immediate
+     * @return Ссылка на добавленный элемент списка
+     */
+    ListBox &addListBox(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<ListBox> onSelect = nullptr, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+        ListBox &newList = m_add(new ListBox(posX, posY, width, height, std::move(onSelect)));
+        newList.setDeliveryPolicy(delivery);
+        return newList;
+    }
+    /**
+     * @brief Добавить элемент списка
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param onSelect ответная функция на выбор элемента = NULL
+     * @param delivery политика доставки выбора = immediate
+     * @return Ссылка на добавленный элемент списка
+     */
+    ListBox &addListBox(const LayoutRect &rect, Callback<ListBox> onSelect = nullptr, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+        return addListBox(rect.x, rect.y, rect.width, rect.height, std::move(onSelect), delivery);
+    }
+    /**
+     * @brief Добавить полосу прогресса
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param maximum значение счётчика, соответствующее заполненной полосе = 100
+     * @return Ссылка на добавленную полосу прогресса
+     */
+    ProgressBar &addProgressBar(SHORT posX, SHORT posY, SHORT width, SHORT height, uint64_t maximum = 100) {
+        return m_add(new ProgressBar(posX, posY, width, height, maximum));
+    }
+    /**
+     * @brief Добавить полосу прогресса
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param maximum значение счётчика, соответствующее заполненной полосе = 100
+     * @return Ссылка на добавленную полосу прогресса
+     */
+    ProgressBar &addProgressBar(const LayoutRect &rect, uint64_t maximum = 100) {
+        return addProgressBar(rect.x, rect.y, rect.width, rect.height, maximum);
+    }
+    /**
+     * @brief Добавить числовой индикатор
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param prefix текст перед значением = ""
+     * @param suffix текст после значения = ""
+     * @param alignText выравнивание = Center
+     * @return Ссылка на добавленный числовой индикатор
+     */
+    Meter &addMeter(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &prefix = L"", const std::wstring &suffix = L"", Align alignText = Align::Center) {
+        return m_add(new Meter(posX, posY, width, height, prefix, suffix, alignText));
+    }
+    /**
+     * @brief Добавить числовой индикатор
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param prefix текст перед значением = ""
+     * @param suffix текст после значения = ""
+     * @param alignText выравнивание = Center
+     * @return Ссылка на добавленный числовой индикатор
+     */
+    Meter &addMeter(const LayoutRect &rect, const std::wstring &prefix = L"", const std::wstring &suffix = L"", Align alignText = Align::Center) {
+        return addMeter(rect.x, rect.y, rect.width, rect.height, prefix, suffix, alignText);
+    }
+    /**
+     * @brief Добавить изображение
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина (AutoSize - по изображению)
+     * @param height высота (AutoSize - по изображению)
+     * @param path путь к файлу изображения = ""
+     * @return Ссылка на добавленное изображение
+     */
+    Image &addImage(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &path = L"") {
+        return m_add(new Image(posX, posY, width, height, path));
+    }
+    /**
+     * @brief Добавить изображение
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param path путь к файлу изображения = ""
+     * @return Ссылка на добавленное изображение
+     */
+    Image &addImage(const LayoutRect &rect, const std::wstring &path = L"") {
+        return addImage(rect.x, rect.y, rect.width, rect.height, path);
+    }
+    /**
+     * @brief Добавить дерево с загрузкой узлов по требованию
+     * @param posX X-координата
+     * @param posY Y-координата
+     * @param width ширина
+     * @param height высота
+     * @param onLoad функция загрузки дочерних узлов (вызывается в фоновом потоке) = NULL
+     * @param rootKey ключ невидимого корня = 0
+     * @param onSelect ответная функция на выбор узла = NULL
+     * @return Ссылка на добавленное дерево
+     */
+    TreeView &addTreeView(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<TreeLoad> onLoad = nullptr, uint64_t rootKey = 0, Callback<TreeView> onSelect = nullptr) {
+        TreeView &newTree = m_add(new TreeView(posX, posY, width, height, std::move(onLoad), rootKey));
+        newTree.setOnSelect(std::move(onSelect));
+        return newTree;
+    }
+    /**
+     * @brief Добавить дерево с загрузкой узлов по требованию
+     * @param rect прямоугольник элемента (см. computeLayout)
+     * @param onLoad функция загрузки дочерних узлов (вызывается в фоновом потоке) = NULL
+     * @param rootKey ключ невидимого корня = 0
+     * @param onSelect ответная функция на выбор узла = NULL
+     * @return Ссылка на добавленное дерево
+     */
+    TreeView &addTreeView(const LayoutRect &rect, Callback<TreeLoad> onLoad = nullptr, uint64_t rootKey = 0, Callback<TreeView> onSelect = nullptr) {
+        return addTreeView(rect.x, rect.y, rect.width, rect.height, std::move(onLoad), rootKey, std::move(onSelect));
+    }
+
+    /**
+     * @brief Найти элемент окна по ИД
+     * @param id ИД элемента
+     * @return Указатель на элемент (nullptr, если в этом окне такого элемента нет)
+     */
+    IElement *findElement(uint64_t id) const;
+
+    /**
+     * @brief Открыть окно (создать дескриптор и элементы)
+     * @details Окно с собственным потоком создаётся в новом потоке; функция возвращается после того, как окно создано.
+     *          Окно без собственного потока обслуживается циклом сообщений вызывающего потока
+     * @param showCommand флаг показа окна (см. ShowWindow) = SW_SHOWDEFAULT
+     * @return T - окно создано, F - ошибка
+     */
+    bool open(int showCommand = SW_SHOWDEFAULT);
+    /**
+     * @brief Закрыть окно (можно вызывать из любого потока)
+     */
+    void close() {
+        if (m_handle)
+            PostMessage(m_handle, WM_CLOSE, (WPARAM)NULL, (LPARAM)NULL);
+    }
+
+protected:
+    friend LRESULT CALLBACK ::MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+    friend struct _M_AppData;
+    friend Window &addWindow(LPCWSTR title, bool isOwnThread);
+    friend void _m_finishEvent(Window *window, RecordedEventType type, IElement *elem, uint64_t startTime);
+    friend class Snapshot;
+
+    int m_posX, m_posY;
+    int m_width, m_height;
+    bool m_isResizeable;
+    DWORD m_style;
+    LPCWSTR m_title;
+    bool m_isMain;
+    bool m_isOwnThread;
+    std::atomic<HWND> m_handle;
+    // Поток окна и поиск элемента по ИД (определены в реализации)
+    struct _M_State;
+    _M_Hidden<_M_State> m_state;
+    std::vector<IElement *> m_elements;
+    _M_ResizeLayout m_layout;
+    Callback<Window> m_onClose;
+    uint32_t m_index;
+    std::atomic<uint64_t> m_lastHandlerTime;
+    std::vector<ISampledElement *> m_sampled;
+    UINT m_sampleInterval;
+
+    template <class T>
+    T &m_add(T *elem) {
+        m_elements.push_back(elem);
+        m_register(elem);
+        if constexpr (std::is_base_of_v<ISampledElement, T>)
+            m_sampled.push_back(elem);
+        return *elem;
+    }
+
+    void m_register(IElement *elem);
+
+    // Элемент, приславший WM_COMMAND, ищется по ИД из дескриптора (LOWORD(wParam) содержит только 16 бит ИД)
+    IElement *m_findElement(HWND control) const {
+        return control ? findElement((uint64_t)GetWindowLongPtr(control, GWLP_ID)) : nullptr;
+    }
+
+    bool m_createHandle(int showCommand) {
+        HWND hWnd = CreateWindow(
+            _M_EZW32_CLASS_NAME,
+            m_title,
+            m_style,
+
+            m_posX,
+            m_posY,
+
+            m_width,
+            m_height,
+
+            NULL,       // Parent window
+            NULL,       // Menu
+            NULL,       // Instance handle
+            this        // Additional application data
+        );
+        if (!hWnd)
+            return false;
+        ShowWindow(hWnd, showCommand);
+        return true;
+    }
+};
+
+/**
+ * @brief Ссылка на Window
+ */
+using RWindow = Reference<Window>;
+
 
 struct _M_AppData {
+    _M_AppData() : m_onExit(nullptr) {
+        m_mainWindow.m_isMain = true;
+    }
     ~_M_AppData() {
-        for (IElement *elem : m_elements)
-            delete elem;
+        // Окна с собственными потоками закрываются и дожидаются до разрушения главного окна
+        m_windows.clear();
+    }
+
+    Window m_mainWindow;
+    std::vector<std::unique_ptr<Window>> m_windows;
+    void (*m_onExit)();
+};
+
+inline _M_AppData _m_appData;
+
+/**
+ * @brief Получить главное окно приложения
+ * @return Ссылка на главное окно
+ */
+inline Window &getMainWindow() {
+    return _m_appData.m_mainWindow;
+}
+/**
+ * @brief Добавить дополнительное окно верхнего уровня
+ * @details Окна, добавленные в Initialize, открываются автоматически; добавленные позже - вызовом Window::open
+ * @param title название окна
+ * @param isOwnThread запускать ли окно в собственном потоке = T
+ * @return Ссылка на добавленное окно
+ */
+inline Window &addWindow(LPCWSTR title = L"window title", bool isOwnThread = true) {
+    Window *newWindow = new Window(title);
+    newWindow->setOwnThread(isOwnThread);
+    newWindow->m_index = (uint32_t)(_m_appData.m_windows.size() + 1);
+    _m_appData.m_windows.emplace_back(newWindow);
+    return *newWindow;
+}
+
+/**
+ * @brief Устанавливает функцию, которая запускается при выходе из программы
+ * @param onExit указатель на функцию
+ */
+inline void setAppOnExit(void (*onExit)()) {
+    _m_appData.m_onExit = onExit;
+}
+/**
+ * @brief Установить положение главного окна на экране
+ * @param x X-координата
+ * @param y Y-координата
+ */
+inline void setWindowPosition(DWORD x, DWORD y) {
+    _m_appData.m_mainWindow.setPosition(x, y);
+}
+/**
+ * @brief Установить размер главного окна
+ * @param width ширина (X-размер)
+ * @param height высота (Y-размер)
+ */
+inline void setWindowSize(DWORD width, DWORD height) {
+    _m_appData.m_mainWindow.setSize(width, height);
+}
+/**
+ * @brief Установить название главного окна
+ * @param title название
+ */
+inline void setWindowTitle(LPCWSTR title) {
+    _m_appData.m_mainWindow.setTitle(title);
+}
+/**
+ * @brief Установить стиль главного окна
+ * @param style флаги стилей (DWORD)
+ */
+inline void setWindowStyle(DWORD style) {
+    _m_appData.m_mainWindow.setStyle(style);
+}
+/**
+ * @brief Установить возможность измены размера главного окна
+ * @details При изменении размера элементы перемещаются согласно своей привязке (см. IElement::setAnchor)
+ * @param value T/F
+ */
+inline void setWindowResizeable(bool value) {
+    _m_appData.m_mainWindow.setResizeable(value);
+}
+/**
+ * @brief Установить период опроса счётчиков ProgressBar и Meter главного окна
+ * @param interval период в мс
+ */
+inline void setWindowSampleInterval(UINT interval) {
+    _m_appData.m_mainWindow.setSampleInterval(interval);
+}
+
+/**
+ * @brief Получить ширину экрана
+ * @return ширина экрана
+ */
+inline int getScreenWidth() { return GetSystemMetrics(SM_CXSCREEN); }
+/**
+ * @brief Получить высоту экрана
+ * @return высота экрана
+ */
+inline int getScreenHeight() { return GetSystemMetrics(SM_CYSCREEN); }
+
+/**
+ * @brief Добавить статичный текстовый элемент в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина (AutoSize - по тексту)
+ * @param height высота (AutoSize - по тексту)
+ * @param text текст = ""
+ * @param alignText выравнивание = Center
+ * @return Ссылка на добавленный статичный текстовый элемент
+ */
+inline Static &addStatic(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Align alignText = Align::Center) {
+    return _m_appData.m_mainWindow.addStatic(posX, posY, width, height, text, alignText);
+}
+/**
+ * @brief Добавить статичный текстовый элемент в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param text текст = ""
+ * @param alignText выравнивание = Center
+ * @return Ссылка на добавленный статичный текстовый элемент
+ */
+inline Static &addStatic(const LayoutRect &rect, const std::wstring &text = L"", Align alignText = Align::Center) {
+    return _m_appData.m_mainWindow.addStatic(rect, text, alignText);
+}
+/**
+ * @brief Добавить кнопку в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина (AutoSize - по тексту)
+ * @param height высота (AutoSize - по тексту)
+ * @param text текст = ""
+ * @param onClick ответная функция на нажатие = NULL
+ * @param alignText выравнивание = Center
+ * @param delivery политика доставки нажатий = immediate
+ * @return Ссылка на добавленную кнопку
+ */
+inline Button &addButton(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Callback<Button> onClick = nullptr, Align alignText = Align::Center, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+    return _m_appData.m_mainWindow.addButton(posX, posY, width, height, text, std::move(onClick), alignText, delivery);
+}
+/**
+ * @brief Добавить кнопку в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param text текст = ""
+ * @param onClick ответная функция на нажатие = NULL
+ * @param alignText выравнивание = Center
+ * @param delivery политика доставки нажатий = immediate
+ * @return Ссылка на добавленную кнопку
+ */
+inline Button &addButton(const LayoutRect &rect, const std::wstring &text = L"", Callback<Button> onClick = nullptr, Align alignText = Align::Center, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+    return _m_appData.m_mainWindow.addButton(rect, text, std::move(onClick), alignText, delivery);
+}
+/**
+ * @brief Добавить элемент текстового ввода в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина (AutoSize - по тексту)
+ * @param height высота (AutoSize - по тексту)
+ * @param isNumberOnly только численный ввод (T/F) = F
+ * @param alignText выравнивание текста = Left
+ * @param presetText начальный текст = ""
+ * @return Ссылка на добавленный элемент текстового ввода
+ */
+inline Edit &addEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, bool isNumberOnly = false, Align alignText = Align::Left, const std::wstring &presetText = L"") {
+    return _m_appData.m_mainWindow.addEdit(posX, posY, width, height, isNumberOnly, alignText, presetText);
+}
+/**
+ * @brief Добавить элемент текстового ввода в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param isNumberOnly только численный ввод (T/F) = F
+ * @param alignText выравнивание текста = Left
+ * @param presetText начальный текст = ""
+ * @return Ссылка на добавленный элемент текстового ввода
+ */
+inline Edit &addEdit(const LayoutRect &rect, bool isNumberOnly = false, Align alignText = Align::Left, const std::wstring &presetText = L"") {
+    return _m_appData.m_mainWindow.addEdit(rect, isNumberOnly, alignText, presetText);
+}
+/**
+ * @brief Добавить поле ввода числа в главное окно
+ * @tparam T тип значения
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина (AutoSize - по тексту)
+ * @param height высота (AutoSize - по тексту)
+ * @param minimum минимальное значение = наименьшее значение T
+ * @param maximum максимальное значение = наибольшее значение T
+ * @param value начальное значение = 0
+ * @param alignText выравнивание текста = Right
+ * @return Ссылка на добавленное поле ввода числа
+ */
+template <NumericValue T>
+NumericEdit<T> &addNumericEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, T minimum = std::numeric_limits<T>::lowest(), T maximum = std::numeric_limits<T>::max(), T value = T(), Align alignText = Align::Right) {
+    return _m_appData.m_mainWindow.addNumericEdit<T>(posX, posY, width, height, minimum, maximum, value, alignText);
+}
+/**
+ * @brief Добавить поле ввода числа в главное окно
+ * @tparam T тип значения
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param minimum минимальное значение = наименьшее значение T
+ * @param maximum максимальное значение = наибольшее значение T
+ * @param value начальное значение = 0
+ * @param alignText выравнивание текста = Right
+ * @return Ссылка на добавленное поле ввода числа
+ */
+template <NumericValue T>
+NumericEdit<T> &addNumericEdit(const LayoutRect &rect, T minimum = std::numeric_limits<T>::lowest(), T maximum = std::numeric_limits<T>::max(), T value = T(), Align alignText = Align::Right) {
+    return _m_appData.m_mainWindow.addNumericEdit<T>(rect, minimum, maximum, value, alignText);
+}
+/**
+ * @brief Добавить элемент списка в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина
+ * @param height высота
+ * @param onSelect ответная функция на выбор элемента = NULL
+ * @param delivery политика доставки выбора = immediate
+ * @return Ссылка на добавленный элемент списка
+ */
+inline ListBox &addListBox(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<ListBox> onSelect = nullptr, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+    return _m_appData.m_mainWindow.addListBox(posX, posY, width, height, std::move(onSelect), delivery);
+}
+/**
+ * @brief Добавить элемент списка в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param onSelect ответная функция на выбор элемента = NULL
+ * @param delivery политика доставки выбора = immediate
+ * @return Ссылка на добавленный элемент списка
+ */
+inline ListBox &addListBox(const LayoutRect &rect, Callback<ListBox> onSelect = nullptr, DeliveryPolicy delivery = DeliveryPolicy::immediate()) {
+    return _m_appData.m_mainWindow.addListBox(rect, std::move(onSelect), delivery);
+}
+/**
+ * @brief Добавить полосу прогресса в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина
+ * @param height высота
+ * @param maximum значение счётчика, соответствующее заполненной полосе = 100
+ * @return Ссылка на добавленную полосу прогресса
+ */
+inline ProgressBar &addProgressBar(SHORT posX, SHORT posY, SHORT width, SHORT height, uint64_t maximum = 100) {
+    return _m_appData.m_mainWindow.addProgressBar(posX, posY, width, height, maximum);
+}
+/**
+ * @brief Добавить полосу прогресса в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param maximum значение счётчика, соответствующее заполненной полосе = 100
+ * @return Ссылка на добавленную полосу прогресса
+ */
+inline ProgressBar &addProgressBar(const LayoutRect &rect, uint64_t maximum = 100) {
+    return _m_appData.m_mainWindow.addProgressBar(rect, maximum);
+}
+/**
+ * @brief Добавить числовой индикатор в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина
+ * @param height высота
+ * @param prefix текст перед значением = ""
+ * @param suffix текст после значения = ""
+ * @param alignText выравнивание = Center
+ * @return Ссылка на добавленный числовой индикатор
+ */
+inline Meter &addMeter(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &prefix = L"", const std::wstring &suffix = L"", Align alignText = Align::Center) {
+    return _m_appData.m_mainWindow.addMeter(posX, posY, width, height, prefix, suffix, alignText);
+}
+/**
+ * @brief Добавить числовой индикатор в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param prefix текст перед значением = ""
+ * @param suffix текст после значения = ""
+ * @param alignText выравнивание = Center
+ * @return Ссылка на добавленный числовой индикатор
+ */
+inline Meter &addMeter(const LayoutRect &rect, const std::wstring &prefix = L"", const std::wstring &suffix = L"", Align alignText = Align::Center) {
+    return _m_appData.m_mainWindow.addMeter(rect, prefix, suffix, alignText);
+}
+/**
+ * @brief Добавить изображение в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина (AutoSize - по изображению)
+ * @param height высота (AutoSize - по изображению)
+ * @param path путь к файлу изображения = ""
+ * @return Ссылка на добавленное изображение
+ */
+inline Image &addImage(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &path = L"") {
+    return _m_appData.m_mainWindow.addImage(posX, posY, width, height, path);
+}
+/**
+ * @brief Добавить изображение в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param path путь к файлу изображения = ""
+ * @return Ссылка на добавленное изображение
+ */
+inline Image &addImage(const LayoutRect &rect, const std::wstring &path = L"") {
+    return _m_appData.m_mainWindow.addImage(rect, path);
+}
+/**
+ * @brief Добавить дерево с загрузкой узлов по требованию в главное окно
+ * @param posX X-координата
+ * @param posY Y-координата
+ * @param width ширина
+ * @param height высота
+ * @param onLoad функция загрузки дочерних узлов (вызывается в фоновом потоке) = NULL
+ * @param rootKey ключ невидимого корня = 0
+ * @param onSelect ответная функция на выбор узла = NULL
+ * @return Ссылка на добавленное дерево
+ */
+inline TreeView &addTreeView(SHORT posX, SHORT posY, SHORT width, SHORT height, Callback<TreeLoad> onLoad = nullptr, uint64_t rootKey = 0, Callback<TreeView> onSelect = nullptr) {
+    return _m_appData.m_mainWindow.addTreeView(posX, posY, width, height, std::move(onLoad), rootKey, std::move(onSelect));
+}
+/**
+ * @brief Добавить дерево с загрузкой узлов по требованию в главное окно
+ * @param rect прямоугольник элемента (см. computeLayout)
+ * @param onLoad функция загрузки дочерних узлов (вызывается в фоновом потоке) = NULL
+ * @param rootKey ключ невидимого корня = 0
+ * @param onSelect ответная функция на выбор узла = NULL
+ * @return Ссылка на добавленное дерево
+ */
+inline TreeView &addTreeView(const LayoutRect &rect, Callback<TreeLoad> onLoad = nullptr, uint64_t rootKey = 0, Callback<TreeView> onSelect = nullptr) {
+    return _m_appData.m_mainWindow.addTreeView(rect, std::move(onLoad), rootKey, std::move(onSelect));
+}
+
+inline uint64_t _m_microseconds() {
+    static const LONGLONG s_frequency = []() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / s_frequency * 1000000 + counter.QuadPart % s_frequency * 1000000 / s_frequency);
+}
+
+inline Window *_m_getWindowByIndex(uint32_t index) {
+    if (index == 0)
+        return &_m_appData.m_mainWindow;
+    return (index <= _m_appData.m_windows.size()) ? _m_appData.m_windows[index - 1].get() : nullptr;
+}
+
+/**
+ * @brief Энумерация типов записываемых событий
+ */
+enum class RecordedEventType : uint8_t { Click, Select, TextChange, Resize, MultiSelect };
+
+/**
+ * @brief Записанное событие окна
+ */
+struct RecordedEvent {
+    uint64_t time;              // время от начала записи в мкс
+    RecordedEventType type;
+    uint32_t window;            // номер окна (см. Window::getIndex)
+    uint64_t element;           // ИД элемента (для Resize - 0)
+    int64_t value;              // индекс выбора (Select) или ширина << 16 | высота (Resize)
+    std::wstring text;          // новый текст (TextChange)
+    std::vector<uint32_t> selection; // выделенные элементы по возрастанию (MultiSelect)
+    uint64_t handlerTime;       // время обработки в мкс
+};
+
+/**
+ * @brief Запись событий окон (нажатия, выбор в списках, изменение текста, изменение размера) в компактный двоичный файл
+ * @details Формат: заголовок "EZW32REC" + версия (uint16), далее записи из varint-полей:
+ *          тип, приращение времени, номер окна, ИД элемента, значение (zigzag), время обработки, [длина текста, UTF-16],
+ *          [число выделенных элементов, разности индексов]. Выбор в списке с множественным выбором (версия 2)
+ *          записывается как MultiSelect со всем набором выделенных элементов, а не как Select
+ */
+class EventRecorder {
+public:
+    static constexpr char s_magic[8] = { 'E', 'Z', 'W', '3', '2', 'R', 'E', 'C' };
+    static constexpr uint16_t s_version = 2;
+
+    /**
+     * @brief Начать запись (предыдущая запись завершается)
+     * @param path путь к файлу
+     * @return T - файл открыт, F - ошибка
+     */
+    static bool start(const std::wstring &path);
+    /**
+     * @brief Завершить запись и закрыть файл
+     */
+    static void stop();
+    /**
+     * @brief Идёт ли запись?
+     * @return T/F
+     */
+    static bool isRecording();
+
+    /**
+     * @brief Записать событие (вызывается автоматически)
+     */
+    static void _m_record(RecordedEventType type, uint32_t window, uint64_t element, int64_t value, std::wstring_view text,
+                          std::span<const uint32_t> selection, uint64_t startTime, uint64_t handlerTime);
+
+protected:
+    friend class EventReplayer;
+
+    // Буфер и файл записи под мьютексом (определены в реализации)
+    struct _M_State;
+
+    static _M_State &s_state();
+
+    static void s_writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+};
+
+/**
+ * @brief Результат воспроизведения одного события
+ */
+struct ReplayResult {
+    RecordedEvent event;
+    uint64_t replayHandlerTime; // время обработки при воспроизведении в мкс
+};
+
+/**
+ * @brief Воспроизведение записанных событий (см. EventRecorder)
+ */
+class EventReplayer {
+public:
+    /**
+     * @brief Загрузить запись из файла
+     * @param path путь к файлу
+     * @return Список событий
+     * @throws Если файл не удалось прочитать или он повреждён (easywindows32::Exception)
+     */
+    static std::vector<RecordedEvent> load(const std::wstring &path) {
+        HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            throw Exception("Cannot open file (easywindows32::EventReplayer::load)");
+        LARGE_INTEGER size = { };
+        GetFileSizeEx(file, &size);
+        std::vector<uint8_t> data((size_t)size.QuadPart);
+        DWORD read = 0;
+        BOOL isRead = data.empty() || ReadFile(file, data.data(), (DWORD)data.size(), &read, NULL);
+        CloseHandle(file);
+        if (!isRead || read != data.size())
+            throw Exception("Cannot read file (easywindows32::EventReplayer::load)");
+        return parse(data.data(), data.size());
+    }
+    /**
+     * @brief Разобрать запись из памяти
+     * @param data данные
+     * @param size размер данных в байтах
+     * @return Список событий
+     * @throws Если данные повреждены или версия не поддерживается (easywindows32::Exception)
+     */
+    static std::vector<RecordedEvent> parse(const uint8_t *data, size_t size) {
+        const uint8_t *ptr = data, *end = data + size;
+        if (size < sizeof(EventRecorder::s_magic) + 2 || std::memcmp(ptr, EventRecorder::s_magic, sizeof(EventRecorder::s_magic)) != 0)
+            throw Exception("Not an event record (easywindows32::EventReplayer::parse)");
+        ptr += sizeof(EventRecorder::s_magic);
+        uint16_t version = (uint16_t)(ptr[0] | (ptr[1] << 8));
+        ptr += 2;
+        if (version < 1 || version > EventRecorder::s_version)
+            throw Exception("Unsupported event record version (easywindows32::EventReplayer::parse)");
+
+        std::vector<RecordedEvent> events;
+        uint64_t time = 0;
+        while (ptr < end) {
+            RecordedEvent event = { };
+            event.type = (RecordedEventType)*ptr++;
+            if (event.type > RecordedEventType::MultiSelect)
+                throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+            time += s_readVarint(ptr, end);
+            event.time = time;
+            event.window = (uint32_t)s_readVarint(ptr, end);
+            event.element = s_readVarint(ptr, end);
+            uint64_t value = s_readVarint(ptr, end);
+            event.value = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            event.handlerTime = s_readVarint(ptr, end);
+            if (event.type == RecordedEventType::TextChange) {
+                uint64_t length = s_readVarint(ptr, end);
+                if (length > (uint64_t)(end - ptr) / 2)
+                    throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+                event.text.resize((size_t)length);
+                for (wchar_t &ch : event.text) {
+                    ch = (wchar_t)(ptr[0] | (ptr[1] << 8));
+                    ptr += 2;
+                }
+            }
+            if (event.type == RecordedEventType::MultiSelect) {
+                uint64_t count = s_readVarint(ptr, end);
+                if (count > (uint64_t)(end - ptr))
+                    throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+                event.selection.resize((size_t)count);
+                uint64_t next = 0;
+                for (uint32_t &index : event.selection) {
+                    next += s_readVarint(ptr, end);
+                    if (next > UINT32_MAX)
+                        throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+                    index = (uint32_t)next++;
+                }
+            }
+            events.push_back(std::move(event));
+        }
+        return events;
+    }
+
+    /**
+     * @brief Воспроизвести события в открытых окнах
+     * @details Функцию нужно вызывать из отдельного потока: события отправляются окнам через SendMessage
+     *          и обрабатываются их собственными циклами сообщений
+     * @param events список событий
+     * @param isRealTime T - с записанными интервалами, F - максимально быстро
+     * @return Результаты с временем обработки каждого события (события для несуществующих окон/элементов пропускаются)
+     */
+    static std::vector<ReplayResult> replay(const std::vector<RecordedEvent> &events, bool isRealTime);
+
+protected:
+    static uint64_t s_readVarint(const uint8_t *&ptr, const uint8_t *end) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (ptr >= end)
+                throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+            uint8_t byte = *ptr++;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw Exception("Corrupted event record (easywindows32::EventReplayer::parse)");
+    }
+};
+
+/**
+ * @brief Снимок состояния элементов окна (текст Edit, элементы и выделение ListBox) в двоичном файле
+ * @details Формат: заголовок "EZW32SNP" + версия (uint16) + резерв (uint16) + число записей (uint32),
+ *          далее записи: ИД элемента (uint64), тип (uint16), резерв (uint16), размер данных (uint32), данные.
+ *          Все поля выровнены на 2 байта, поэтому строки читаются прямо из отображённого в память файла.
+ *          Версия 2 добавляет в запись ListBox полный набор выделенных элементов; файлы версии 1 по-прежнему читаются
+ */
+class Snapshot {
+public:
+    static constexpr char s_magic[8] = { 'E', 'Z', 'W', '3', '2', 'S', 'N', 'P' };
+    static constexpr uint16_t s_version = 2;
+
+    /**
+     * @brief Сохранить состояние элементов окна
+     * @param window окно (если окно открыто, функцию нужно вызывать из его потока)
+     * @param path путь к файлу
+     * @return T - сохранено, F - ошибка записи
+     */
+    static bool save(Window &window, const std::wstring &path) {
+        std::vector<uint8_t> out(s_headerSize);
+        uint32_t count = 0;
+        for (IElement *elem : window.m_elements) {
+            uint16_t type = elem->m_getStateType();
+            if (!type)
+                continue;
+            _m_writeValue<uint64_t>(out, elem->getID());
+            _m_writeValue<uint16_t>(out, type);
+            _m_writeValue<uint16_t>(out, 0);
+            size_t sizeOffset = out.size();
+            _m_writeValue<uint32_t>(out, 0);
+            elem->m_saveState(out);
+            uint32_t size = (uint32_t)(out.size() - sizeOffset - sizeof(uint32_t));
+            std::memcpy(out.data() + sizeOffset, &size, sizeof(size));
+            count++;
+        }
+        std::memcpy(out.data(), s_magic, sizeof(s_magic));
+        std::memcpy(out.data() + 8, &s_version, sizeof(s_version));
+        std::memcpy(out.data() + 12, &count, sizeof(count));
+
+        HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        DWORD written = 0;
+        BOOL isWritten = WriteFile(file, out.data(), (DWORD)out.size(), &written, NULL);
+        CloseHandle(file);
+        return isWritten && written == out.size();
+    }
+
+    /**
+     * @brief Восстановить состояние элементов окна
+     * @details Может вызываться в Initialize (до создания окна) - тогда списки заполняются сразу при создании.
+     *          Записи для отсутствующих элементов или элементов другого типа пропускаются
+     * @param window окно (если окно открыто, функцию нужно вызывать из его потока)
+     * @param path путь к файлу
+     * @return T - восстановлено, F - файла нет или его не удалось открыть
+     * @throws Если файл повреждён или версия не поддерживается (easywindows32::Exception)
+     */
+    static bool load(Window &window, const std::wstring &path) {
+        HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size = { };
+        GetFileSizeEx(file, &size);
+        HANDLE mapping = size.QuadPart ? CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        CloseHandle(file);
+        if (!mapping)
+            throw Exception("Corrupted snapshot (easywindows32::Snapshot::load)");
+        const uint8_t *data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (!data)
+            return false;
+
+        try {
+            s_apply(window, data, (size_t)size.QuadPart);
+        } catch (...) {
+            UnmapViewOfFile(data);
+            throw;
+        }
+        UnmapViewOfFile(data);
+        return true;
+    }
+
+protected:
+    static constexpr size_t s_headerSize = 16;
+
+    static void s_apply(Window &window, const uint8_t *data, size_t size) {
+        _M_ByteReader in = { data, data + size, "Corrupted snapshot (easywindows32::Snapshot::load)", 0 };
+        in.m_require(s_headerSize);
+        if (std::memcmp(data, s_magic, sizeof(s_magic)) != 0)
+            throw Exception("Not a snapshot (easywindows32::Snapshot::load)");
+        in.m_ptr += sizeof(s_magic);
+        in.m_version = in.m_read<uint16_t>();
+        if (in.m_version < 1 || in.m_version > s_version)
+            throw Exception("Unsupported snapshot version (easywindows32::Snapshot::load)");
+        in.m_read<uint16_t>();
+        uint32_t count = in.m_read<uint32_t>();
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t id = in.m_read<uint64_t>();
+            uint16_t type = in.m_read<uint16_t>();
+            in.m_read<uint16_t>();
+            uint32_t recordSize = in.m_read<uint32_t>();
+            in.m_require(recordSize);
+            _M_ByteReader record = { in.m_ptr, in.m_ptr + recordSize, in.m_error, in.m_version };
+            in.m_ptr += recordSize;
+            IElement *elem = window.findElement(id);
+            if (elem && elem->m_getStateType() == type)
+                elem->m_loadState(record);
+        }
+    }
+};
+
+/**
+ * @brief Сохранить состояние элементов главного окна (см. Snapshot::save)
+ * @param path путь к файлу
+ * @return T - сохранено, F - ошибка записи
+ */
+inline bool saveSnapshot(const std::wstring &path) {
+    return Snapshot::save(_m_appData.m_mainWindow, path);
+}
+/**
+ * @brief Восстановить состояние элементов главного окна (см. Snapshot::load)
+ * @param path путь к файлу
+ * @return T - восстановлено, F - файла нет или его не удалось открыть
+ * @throws Если файл повреждён или версия не поддерживается (easywindows32::Exception)
+ */
+inline bool loadSnapshot(const std::wstring &path) {
+    return Snapshot::load(_m_appData.m_mainWindow, path);
+}
+
+inline void _m_finishEvent(Window *window, RecordedEventType type, IElement *elem, uint64_t startTime) {
+    uint64_t handlerTime = _m_microseconds() - startTime;
+    window->m_lastHandlerTime = handlerTime;
+    if (!EventRecorder::isRecording())
+        return;
+    HWND control = elem ? elem->getHandle() : NULL;
+    int64_t value = 0;
+    std::wstring text;
+    std::span<const uint32_t> selection;
+    switch (type) {
+    case RecordedEventType::Select: {
+        // В списке с множественным выбором LB_GETCURSEL возвращает позицию курсора, поэтому пишется весь набор
+        ListBox *lb = dynamic_cast<ListBox *>(elem);
+        if (lb && lb->isMultiSelect()) {
+            type = RecordedEventType::MultiSelect;
+            selection = lb->getSelectedIndices();
+        } else {
+            value = SendMessage(control, LB_GETCURSEL, (WPARAM)NULL, (LPARAM)NULL);
+        }
+        break;
+    }
+    case RecordedEventType::TextChange:
+        text.resize(GetWindowTextLength(control) + 1);
+        text.resize(GetWindowText(control, &text[0], (int)text.size()));
+        break;
+    case RecordedEventType::Resize: {
+        RECT client;
+        GetClientRect(window->getHandle(), &client);
+        value = ((int64_t)(client.right - client.left) << 16) | (client.bottom - client.top);
+        break;
+    }
+    default:
+        break;
+    }
+    EventRecorder::_m_record(type, window->getIndex(), elem ? elem->getID() : 0, value, text, selection, startTime, handlerTime);
+}
+
+/**
+ * @brief Энумерация стандартных звуков Windows
+ */
+enum class WindowsSound { Warning, Error };
+
+/**
+ * @brief Проиграть стандартный звук Windows
+ * @param sound звук
+ */
+inline void playWindowsSound(WindowsSound sound) {
+    switch (sound) {
+    case WindowsSound::Warning: MessageBeep(MB_ICONWARNING);    break;
+    case WindowsSound::Error:   MessageBeep(MB_ICONERROR);      break;
+    default: break;
+    }
+}
+
+/**
+ * @brief Функция инициализации элементов окна, вызывается автоматически (один раз)
+ * @warning Функция должна быть определена в файле приложения, иначе код не скомпилируется
+ */
+extern void Initialize();
+
+} // namespace easywindows32
+
+#ifdef _M_EZW32_IMPLEMENT
+
+namespace easywindows32 {
+
+template <class T>
+void _M_HiddenDelete<T>::operator ()(T *ptr) const {
+    delete ptr;
+}
+
+// Задаёт строке размер capacity и передаёт её буфер в write, которая возвращает итоговую длину. С resize_and_overwrite (C++23)
+// буфер не заполняется нулями перед записью; без неё нулями заполняется только прирост сверх текущего размера строки
+template <class String, class Write>
+static void _m_overwrite(String &out, size_t capacity, Write write) {
+#ifdef __cpp_lib_string_resize_and_overwrite
+    out.resize_and_overwrite(capacity, [&write](typename String::value_type *data, size_t) { return write(data); });
+#else
+    out.resize(capacity);
+    out.resize(write(out.data()));
+#endif
+}
+
+void utf8ToUtf16(std::string_view utf8, std::wstring &out) {
+    _m_overwrite(out, utf8.size(), [utf8](wchar_t *data) {
+        const uint8_t *src = (const uint8_t *)utf8.data();
+        const uint8_t *end = src + utf8.size();
+        wchar_t *dst = data;
+
+        while (src < end) {
+#ifdef _M_EZW32_SSE2
+            if constexpr (sizeof(wchar_t) == 2) {
+                const __m128i zero = _mm_setzero_si128();
+                while (end - src >= 16) {
+                    __m128i chunk = _mm_loadu_si128((const __m128i *)src);
+                    if (_mm_movemask_epi8(chunk))
+                        break;
+                    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(chunk, zero));
+                    _mm_storeu_si128((__m128i *)(dst + 8), _mm_unpackhi_epi8(chunk, zero));
+                    src += 16;
+                    dst += 16;
+                }
+                if (src >= end)
+                    break;
+            }
+#endif
+            uint32_t cp = *src++;
+            if (cp < 0x80) {
+                *dst++ = (wchar_t)cp;
+                continue;
+            }
+            int extra = (cp >= 0xF0 && cp < 0xF5) ? 3 : (cp >= 0xE0) ? 2 : (cp >= 0xC2) ? 1 : -1;
+            if (cp >= 0xF5 || extra < 0 || end - src < extra) {
+                *dst++ = (wchar_t)0xFFFD;
+                continue;
+            }
+            cp &= (0x3F >> extra);
+            bool isValid = true;
+            for (int i = 0; i < extra; i++) {
+                if ((src[i] & 0xC0) != 0x80) {
+                    isValid = false;
+                    break;
+                }
+                cp = (cp << 6) | (src[i] & 0x3F);
+            }
+            // Отбрасываются избыточно длинные формы, суррогаты и значения за пределами Unicode
+            if (!isValid || (extra == 2 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) || (extra == 3 && (cp < 0x10000 || cp > 0x10FFFF))) {
+                *dst++ = (wchar_t)0xFFFD;
+                continue;
+            }
+            src += extra;
+            if (cp >= 0x10000 && sizeof(wchar_t) == 2) {
+                cp -= 0x10000;
+                *dst++ = (wchar_t)(0xD800 | (cp >> 10));
+                *dst++ = (wchar_t)(0xDC00 | (cp & 0x3FF));
+            } else {
+                *dst++ = (wchar_t)cp;
+            }
+        }
+        return (size_t)(dst - data);
+    });
+}
+
+void utf16ToUtf8(std::wstring_view utf16, std::string &out) {
+    _m_overwrite(out, utf16.size() * (sizeof(wchar_t) == 2 ? 3 : 4), [utf16](char *data) {
+        const wchar_t *src = utf16.data();
+        const wchar_t *end = src + utf16.size();
+        char *dst = data;
+
+        while (src < end) {
+#ifdef _M_EZW32_SSE2
+            if constexpr (sizeof(wchar_t) == 2) {
+                const __m128i highMask = _mm_set1_epi16((short)0xFF80);
+                const __m128i zero = _mm_setzero_si128();
+                while (end - src >= 8) {
+                    __m128i chunk = _mm_loadu_si128((const __m128i *)src);
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, highMask), zero)) != 0xFFFF)
+                        break;
+                    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(chunk, chunk));
+                    src += 8;
+                    dst += 8;
+                }
+                if (src >= end)
+                    break;
+            }
+#endif
+            uint32_t cp = (uint32_t)*src++;
+            if (cp >= 0xD800 && cp <= 0xDFFF && sizeof(wchar_t) == 2) {
+                if (cp <= 0xDBFF && src < end && (uint32_t)*src >= 0xDC00 && (uint32_t)*src <= 0xDFFF)
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + ((uint32_t)*src++ - 0xDC00);
+                else
+                    cp = 0xFFFD;
+            }
+            if (cp < 0x80) {
+                *dst++ = (char)cp;
+            } else if (cp < 0x800) {
+                *dst++ = (char)(0xC0 | (cp >> 6));
+                *dst++ = (char)(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                *dst++ = (char)(0xE0 | (cp >> 12));
+                *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                *dst++ = (char)(0x80 | (cp & 0x3F));
+            } else {
+                // Суррогатная пара (2 символа UTF-16) даёт 4 байта, так что запаса в 3 байта на символ хватает
+                *dst++ = (char)(0xF0 | (cp >> 18));
+                *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+                *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                *dst++ = (char)(0x80 | (cp & 0x3F));
+            }
+        }
+        return (size_t)(dst - data);
+    });
+}
+
+// Текст записи лежит в m_textPool кэша, поэтому ключ не выделяет память сам
+struct TextMeasure::_M_Key {
+    HFONT m_font;
+    size_t m_hash;
+    uint32_t m_offset;
+    uint32_t m_length;
+};
+// Ключ поиска: текст ещё не скопирован в m_textPool
+struct TextMeasure::_M_Probe {
+    HFONT m_font;
+    size_t m_hash;
+    std::wstring_view m_text;
+};
+struct TextMeasure::_M_KeyHash {
+    using is_transparent = void;
+    size_t operator ()(const _M_Key &key) const { return s_combine(key.m_font, key.m_hash); }
+    size_t operator ()(const _M_Probe &probe) const { return s_combine(probe.m_font, probe.m_hash); }
+    static size_t s_combine(HFONT font, size_t hash) {
+        return hash ^ (std::hash<const void *>()(font) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+    }
+};
+// Равные хэши не означают равные строки: сравнивается сам текст
+struct TextMeasure::_M_KeyEqual {
+    using is_transparent = void;
+    const std::vector<wchar_t> *m_pool;
+    std::wstring_view m_text(const _M_Key &key) const { return std::wstring_view(m_pool->data() + key.m_offset, key.m_length); }
+    std::wstring_view m_text(const _M_Probe &probe) const { return probe.m_text; }
+    template <class A, class B>
+    bool operator ()(const A &a, const B &b) const {
+        return a.m_font == b.m_font && a.m_hash == b.m_hash && m_text(a) == m_text(b);
+    }
+};
+struct TextMeasure::_M_FontData {
+    LONG m_lineHeight;
+    std::array<std::unique_ptr<_M_Page>, 256> m_pages;
+};
+
+struct TextMeasure::_M_Cache {
+    HDC m_hdc;
+    HFONT m_selected;
+    std::vector<wchar_t> m_textPool;
+    std::unordered_map<_M_Key, SIZE, _M_KeyHash, _M_KeyEqual> m_extents;
+    std::unordered_map<HFONT, std::unique_ptr<_M_FontData>> m_fonts;
+    TextMeasureStats m_stats;
+
+    _M_Cache() :
+        m_hdc(CreateCompatibleDC(NULL)),
+        m_selected(NULL),
+        m_extents(0, _M_KeyHash(), _M_KeyEqual{ &m_textPool }),
+        m_stats()
+        { }
+    ~_M_Cache() { if (m_hdc) DeleteDC(m_hdc); }
+
+    _M_FontData &m_select(HFONT font) {
+        _M_FontData &data = m_fontData(font);
+        if (m_selected != font) {
+            SelectObject(m_hdc, font);
+            m_selected = font;
+        }
+        return data;
+    }
+    _M_FontData &m_fontData(HFONT font) {
+        std::unique_ptr<_M_FontData> &data = m_fonts[font];
+        if (!data) {
+            data = std::make_unique<_M_FontData>();
+            SelectObject(m_hdc, font);
+            m_selected = font;
+            TEXTMETRIC tm = { };
+            GetTextMetrics(m_hdc, &tm);
+            data->m_lineHeight = tm.tmHeight;
+        }
+        return *data;
+    }
+    std::unique_ptr<_M_Page> m_loadPage(HFONT font, uint16_t page) {
+        m_select(font);
+        int widths[256] = { };
+        GetCharWidth32(m_hdc, (UINT)page << 8, ((UINT)page << 8) | 0xFF, widths);
+        auto result = std::make_unique<_M_Page>();
+        for (size_t i = 0; i < 256; i++)
+            (*result)[i] = (uint16_t)std::max(0, widths[i]);
+        return result;
+    }
+};
+
+TextMeasure::_M_Cache &TextMeasure::s_cache() {
+    static thread_local _M_Cache cache;
+    return cache;
+}
+
+SIZE TextMeasure::measure(HFONT font, std::wstring_view text) {
+    _M_Cache &cache = s_cache();
+    font = s_resolve(font);
+    _M_Probe probe = { font, std::hash<std::wstring_view>()(text), text };
+    auto it = cache.m_extents.find(probe);
+    if (it != cache.m_extents.end()) {
+        cache.m_stats.hits++;
+        return it->second;
+    }
+    cache.m_stats.misses++;
+    _M_FontData &data = cache.m_select(font);
+    SIZE extent = { 0, 0 };
+    if (!text.empty())
+        GetTextExtentPoint32(cache.m_hdc, text.data(), (int)text.size(), &extent);
+    extent.cy = std::max(extent.cy, data.m_lineHeight);
+    // Строка длиннее всего запаса не кэшируется
+    if (text.size() > s_maxChars)
+        return extent;
+    if (cache.m_extents.size() >= s_maxEntries || cache.m_textPool.size() + text.size() > s_maxChars) {
+        cache.m_extents.clear();
+        cache.m_textPool.clear();
+    }
+    _M_Key key = { font, probe.m_hash, (uint32_t)cache.m_textPool.size(), (uint32_t)text.size() };
+    cache.m_textPool.insert(cache.m_textPool.end(), text.begin(), text.end());
+    cache.m_extents.emplace(key, extent);
+    return extent;
+}
+
+SIZE TextMeasure::estimate(HFONT font, std::wstring_view text) {
+    _M_Cache &cache = s_cache();
+    font = s_resolve(font);
+    _M_FontData &data = cache.m_fontData(font);
+    LONG width = 0;
+    for (wchar_t ch : text) {
+        auto &page = data.m_pages[(uint16_t)ch >> 8];
+        if (!page)
+            page = cache.m_loadPage(font, (uint16_t)ch >> 8);
+        width += (*page)[(uint16_t)ch & 0xFF];
+    }
+    return { width, data.m_lineHeight };
+}
+
+LONG TextMeasure::getLineHeight(HFONT font) {
+    return s_cache().m_fontData(s_resolve(font)).m_lineHeight;
+}
+
+TextMeasureStats TextMeasure::getStats() {
+    _M_Cache &cache = s_cache();
+    TextMeasureStats stats = cache.m_stats;
+    stats.entries = cache.m_extents.size();
+    return stats;
+}
+
+void TextMeasure::clear() {
+    _M_Cache &cache = s_cache();
+    cache.m_extents.clear();
+    cache.m_textPool.clear();
+    cache.m_fonts.clear();
+    cache.m_stats = { };
+}
+
+void ProgressBar::create(HWND parent) {
+    m_handle = CreateWindow(
+        m_className,
+        NULL,
+        WS_CHILD | WS_VISIBLE,
+        m_pos.X, m_pos.Y,
+        m_size.X, m_size.Y,
+        parent, (HMENU)m_id,
+        NULL,
+        NULL
+    );
+    m_range = 0;
+    m_shownPos = -1;
+    _m_sample();
+}
+
+void ProgressBar::_m_sample() {
+    if (!m_handle)
+        return;
+    // Одна единица диапазона - один пиксель ширины, поэтому равные положения выглядят одинаково
+    int range = std::max<int>(m_size.X, 1);
+    if (range != m_range) {
+        m_range = range;
+        m_shownPos = -1;
+        SendMessage(m_handle, PBM_SETRANGE32, (WPARAM)0, (LPARAM)range);
+    }
+    uint64_t value = m_counter->load(std::memory_order_relaxed);
+    uint64_t maximum = m_maximum.load(std::memory_order_relaxed);
+    int pos = maximum ? (int)((double)std::min(value, maximum) / (double)maximum * range) : 0;
+    if (pos == m_shownPos)
+        return;
+    m_shownPos = pos;
+    SendMessage(m_handle, PBM_SETPOS, (WPARAM)pos, (LPARAM)NULL);
+}
+
+/**
+ * @brief Фоновый поток загрузки дочерних узлов TreeView
+ */
+struct _M_TreeLoader {
+    struct _M_Job {
+        uint32_t m_node;
+        uint32_t m_generation;
+        uint64_t m_key;
+        uint64_t m_epoch;
+        std::vector<TreeItem> m_children;
+        size_t m_inserted = 0;              // сколько узлов уже передано дереву
+        uint32_t m_lastChild = UINT32_MAX;
+        void *m_lastItem = nullptr;         // HTREEITEM последнего вставленного узла
+    };
+
+    HWND m_window;
+    uint64_t m_elemId;
+    Callback<TreeLoad> m_load;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<_M_Job> m_jobs;
+    std::deque<_M_Job> m_ready;
+    bool m_isPosted = false;
+    bool m_isStopping = false;
+    std::atomic<uint64_t> m_epoch = 0;
+    std::deque<_M_Job> m_applying;          // забранные деревом результаты; только поток окна
+
+    _M_TreeLoader(HWND window, uint64_t elemId, Callback<TreeLoad> load) :
+        m_window(window), m_elemId(elemId), m_load(std::move(load)) { }
+
+    ~_M_TreeLoader() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isStopping = true;
+        }
+        m_epoch++;
+        m_wake.notify_one();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void m_push(_M_Job &&job) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+            if (!m_thread.joinable())
+                m_thread = std::thread([this]() { m_run(); });
+        }
+        m_wake.notify_one();
+    }
+
+    // Дерево забирает готовые узлы по сообщению; пока оно не пришло, новые результаты к нему добавляются без нового сообщения
+    void m_post() {
+        if (m_isPosted)
+            return;
+        m_isPosted = true;
+        PostMessage(m_window, _M_EZW32_WM_TREE_UPDATE, (WPARAM)m_elemId, (LPARAM)NULL);
+    }
+
+    void m_run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_wake.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+            if (m_isStopping)
+                return;
+            _M_Job job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            lock.unlock();
+            TreeLoad load(job.m_key, job.m_epoch, &m_epoch);
+            if (m_load && !load.isCancelled()) {
+                // Исключение функции загрузки не должно завершать программу: узел остаётся без дочерних
+                try {
+                    m_load(load);
+                } catch (...) {
+                    load.children.clear();
+                }
+            }
+            job.m_children = std::move(load.children);
+            lock.lock();
+            if (job.m_epoch != m_epoch)
+                continue;
+            m_ready.push_back(std::move(job));
+            m_post();
+        }
+    }
+};
+template struct _M_HiddenDelete<_M_TreeLoader>;
+
+void TreeView::create(HWND parent) {
+    m_handle = CreateWindow(
+        m_className,
+        L"",
+        WS_CHILD | WS_VISIBLE | WS_BORDER | TVS_HASBUTTONS | TVS_HASLINES | TVS_LINESATROOT | TVS_SHOWSELALWAYS,
+        m_pos.X, m_pos.Y,
+        m_size.X, m_size.Y,
+        parent, (HMENU)m_id,
+        NULL,
+        NULL
+    );
+    m_bindFont();
+    // Дерево нового дескриптора пусто, поэтому узлы прошлого открытия окна загружаются заново
+    m_loader.reset();
+    m_collapsed.clear();
+    m_collapsedHead = 0;
+    m_loadingCount = 0;
+    m_selected = { };
+    m_freeChildren(0);
+    m_request(0);
+}
+
+void TreeView::m_request(uint32_t index) {
+    _M_Node &node = m_nodes[index];
+    node.m_state = _M_State::Loading;
+    m_loadingCount++;
+    if (!m_loader)
+        m_loader.reset(new _M_TreeLoader(GetParent(m_handle), m_id, m_onLoad));
+    m_loader->m_push({ index, node.m_generation, node.m_key, m_loader->m_epoch.load(), { } });
+}
+
+void TreeView::expand(TreeNode node) {
+    m_node(node, "Node has been unloaded (easywindows32::TreeView::expand)");
+    _M_Node &target = m_nodes[node.index];
+    if (!m_handle)
+        return;
+    if (target.m_state == _M_State::NotLoaded) {
+        // Узел раскроется, когда придёт первая пачка дочерних узлов
+        if (target.m_hasChildren)
+            m_request(node.index);
+        return;
+    }
+    if (target.m_firstChild != UINT32_MAX)
+        m_expandItem(node.index);
+}
+
+void TreeView::collapse(TreeNode node) {
+    m_node(node, "Node has been unloaded (easywindows32::TreeView::collapse)");
+    if (!m_handle)
+        return;
+    SendMessage(m_handle, TVM_EXPAND, (WPARAM)TVE_COLLAPSE, (LPARAM)m_nodes[node.index].m_item);
+    // Повторное сворачивание через TVM_EXPAND не присылает TVN_ITEMEXPANDED
+    if (m_nodes[node.index].m_isExpanded)
+        m_onCollapsed(node.index);
+}
+
+void TreeView::reset() {
+    if (m_loader) {
+        std::lock_guard<std::mutex> lock(m_loader->m_mutex);
+        m_loader->m_jobs.clear();
+        m_loader->m_ready.clear();
+        m_loader->m_epoch++;
+        m_loader->m_applying.clear();
+    }
+    m_collapsed.clear();
+    m_collapsedHead = 0;
+    m_loadingCount = 0;
+    m_selected = { };
+    if (m_handle) {
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)FALSE, (LPARAM)NULL);
+        SendMessage(m_handle, TVM_DELETEITEM, (WPARAM)NULL, (LPARAM)TVI_ROOT);
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM)NULL);
+        InvalidateRect(m_handle, NULL, TRUE);
+    }
+    m_freeChildren(0);
+    if (m_handle)
+        m_request(0);
+}
+
+LRESULT TreeView::_m_notify(const NMHDR &header) {
+    switch (header.code) {
+    case TVN_GETDISPINFO: {
+        NMTVDISPINFO &info = (NMTVDISPINFO &)header;
+        uint32_t index = (uint32_t)info.item.lParam;
+        if ((info.item.mask & TVIF_TEXT) && index < m_nodes.size())
+            lstrcpyn(info.item.pszText, m_textPool.data() + m_nodes[index].m_textOffset, info.item.cchTextMax);
+        return 0;
+    }
+    case TVN_ITEMEXPANDING: {
+        const NMTREEVIEW &info = (const NMTREEVIEW &)header;
+        uint32_t index = (uint32_t)info.itemNew.lParam;
+        if ((info.action & TVE_ACTIONMASK) != TVE_EXPAND || index >= m_nodes.size())
+            return FALSE;
+        if (m_nodes[index].m_state == _M_State::NotLoaded) {
+            m_request(index);
+            return TRUE;
+        }
+        // Пока не пришла первая пачка, раскрывать нечего
+        return (m_nodes[index].m_firstChild == UINT32_MAX);
+    }
+    case TVN_ITEMEXPANDED: {
+        const NMTREEVIEW &info = (const NMTREEVIEW &)header;
+        uint32_t index = (uint32_t)info.itemNew.lParam;
+        if (index >= m_nodes.size())
+            return 0;
+        if ((info.action & TVE_ACTIONMASK) == TVE_EXPAND)
+            m_nodes[index].m_isExpanded = true;
+        else if (m_nodes[index].m_isExpanded)
+            m_onCollapsed(index);
+        return 0;
+    }
+    case TVN_SELCHANGED: {
+        const NMTREEVIEW &info = (const NMTREEVIEW &)header;
+        uint32_t index = (uint32_t)info.itemNew.lParam;
+        m_selected = (info.itemNew.hItem && index < m_nodes.size()) ? m_handleOf(index) : TreeNode();
+        return 0;
+    }
+    }
+    return 0;
+}
+
+void TreeView::_m_onUpdate() {
+    // Загрузчик создаётся вместе с дескриптором (см. create), и без него узлов, которые нужно вставить или выгрузить, нет
+    if (!m_handle || !m_loader)
+        return;
+    std::deque<_M_TreeLoader::_M_Job> &applying = m_loader->m_applying;
+    {
+        std::lock_guard<std::mutex> lock(m_loader->m_mutex);
+        for (_M_TreeLoader::_M_Job &job : m_loader->m_ready)
+            applying.push_back(std::move(job));
+        m_loader->m_ready.clear();
+        m_loader->m_isPosted = false;
+    }
+
+    // За один вызов вставляется не больше s_batchSize узлов, остальные - по таймеру. WM_TIMER выбирается из очереди
+    // только после ввода и перерисовки, поэтому между пачками окно остаётся отзывчивым
+    HWND parentWindow = GetParent(m_handle);
+    KillTimer(parentWindow, (UINT_PTR)m_id | _M_EZW32_TREE_TIMER_FLAG);
+    size_t budget = s_batchSize;
+    bool isRedrawOff = false;
+    while (budget && !applying.empty()) {
+        _M_TreeLoader::_M_Job &job = applying.front();
+        const _M_Node &parent = m_nodes[job.m_node];
+        if (parent.m_isFree || parent.m_generation != job.m_generation || parent.m_state != _M_State::Loading) {
+            // Узел выгружен, пока загружались его дочерние
+            applying.pop_front();
+            m_loadingCount--;
+            continue;
+        }
+        if (!isRedrawOff) {
+            SendMessage(m_handle, WM_SETREDRAW, (WPARAM)FALSE, (LPARAM)NULL);
+            isRedrawOff = true;
+        }
+        bool isFirst = (job.m_inserted == 0);
+        size_t end = std::min(job.m_children.size(), job.m_inserted + budget);
+        budget -= end - job.m_inserted;
+
+        TVINSERTSTRUCT insert = { };
+        insert.hParent = job.m_node ? (HTREEITEM)parent.m_item : TVI_ROOT;
+        insert.item.mask = TVIF_TEXT | TVIF_CHILDREN | TVIF_PARAM;
+        insert.item.pszText = LPSTR_TEXTCALLBACK;
+        for (; job.m_inserted < end; job.m_inserted++) {
+            TreeItem &item = job.m_children[job.m_inserted];
+            uint32_t index = m_allocNode();
+            _M_Node &node = m_nodes[index];
+            m_setText(node, item.text);
+            node.m_key = item.key;
+            node.m_hasChildren = item.hasChildren;
+            node.m_parent = job.m_node;
+            if (job.m_lastChild == UINT32_MAX)
+                m_nodes[job.m_node].m_firstChild = index;
+            else
+                m_nodes[job.m_lastChild].m_nextSibling = index;
+            job.m_lastChild = index;
+            // Вставка после известного элемента не обходит список братьев, в отличие от TVI_LAST
+            insert.hInsertAfter = job.m_lastItem ? (HTREEITEM)job.m_lastItem : TVI_LAST;
+            insert.item.cChildren = item.hasChildren ? 1 : 0;
+            insert.item.lParam = (LPARAM)index;
+            node.m_item = (void *)SendMessage(m_handle, TVM_INSERTITEM, (WPARAM)NULL, (LPARAM)&insert);
+            job.m_lastItem = node.m_item;
+        }
+
+        uint32_t index = job.m_node;
+        if (isFirst && index && !job.m_children.empty())
+            m_expandItem(index);
+        if (job.m_inserted < job.m_children.size())
+            break;
+        _M_Node &target = m_nodes[index];
+        target.m_state = _M_State::Loaded;
+        m_loadingCount--;
+        if (index && job.m_children.empty()) {
+            // Узел оказался пустым: кнопка раскрытия убирается
+            target.m_hasChildren = false;
+            TVITEM item = { };
+            item.mask = TVIF_HANDLE | TVIF_CHILDREN;
+            item.hItem = (HTREEITEM)target.m_item;
+            item.cChildren = 0;
+            SendMessage(m_handle, TVM_SETITEM, (WPARAM)NULL, (LPARAM)&item);
+        }
+        // Узел, свёрнутый до конца загрузки, сразу становится кандидатом на выгрузку
+        if (index && !target.m_isExpanded)
+            m_onCollapsed(index);
+        applying.pop_front();
+    }
+    if (isRedrawOff) {
+        SendMessage(m_handle, WM_SETREDRAW, (WPARAM)TRUE, (LPARAM)NULL);
+        InvalidateRect(m_handle, NULL, TRUE);
+    }
+    if (!applying.empty())
+        SetTimer(parentWindow, (UINT_PTR)m_id | _M_EZW32_TREE_TIMER_FLAG, USER_TIMER_MINIMUM, NULL);
+    m_trim();
+}
+
+void TreeView::m_expandItem(uint32_t index) {
+    SendMessage(m_handle, TVM_EXPAND, (WPARAM)TVE_EXPAND, (LPARAM)m_nodes[index].m_item);
+    m_nodes[index].m_isExpanded = (SendMessage(m_handle, TVM_GETITEMSTATE, (WPARAM)m_nodes[index].m_item, (LPARAM)TVIS_EXPANDED) & TVIS_EXPANDED) != 0;
+}
+
+void TreeView::m_unload(uint32_t index) {
+    // TVE_COLLAPSERESET удаляет дочерние элементы дерева, а кнопка раскрытия возвращается явно
+    SendMessage(m_handle, TVM_EXPAND, (WPARAM)(TVE_COLLAPSE | TVE_COLLAPSERESET), (LPARAM)m_nodes[index].m_item);
+    TVITEM item = { };
+    item.mask = TVIF_HANDLE | TVIF_CHILDREN;
+    item.hItem = (HTREEITEM)m_nodes[index].m_item;
+    item.cChildren = 1;
+    SendMessage(m_handle, TVM_SETITEM, (WPARAM)NULL, (LPARAM)&item);
+    m_freeChildren(index);
+}
+
+/**
+ * @brief Фоновый обход перетащенных файлов и папок с передачей путей в окно пачками
+ */
+struct _M_FileIntake {
+    static constexpr size_t s_batchSize = 4096;
+    static constexpr uint64_t s_batchInterval = 50;     // мс
+    static constexpr size_t s_maxReady = 16 * s_batchSize;  // столько путей может ждать окно, дальше обход ждёт его
+
+    HWND m_window;
+    uint64_t m_elemId;
+    bool m_isRecursive;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_taken;    // окно забрало готовые пути (или приём отменён)
+    std::deque<std::wstring> m_roots;
+    std::vector<std::wstring> m_ready;
+    bool m_isPosted = false;
+    bool m_isFinished = false;
+    std::atomic<bool> m_isCancelled = false;
+    std::atomic<uint64_t> m_count = 0;
+    std::chrono::steady_clock::time_point m_startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point m_endTime;
+
+    _M_FileIntake(HWND window, uint64_t elemId, bool isRecursive) :
+        m_window(window), m_elemId(elemId), m_isRecursive(isRecursive) { }
+
+    ~_M_FileIntake() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isCancelled = true;
+        }
+        m_taken.notify_one();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Добавить корни в работающий обход; F - обход уже завершается, нужен новый
+    bool m_append(std::vector<std::wstring> &paths) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_isFinished)
+            return false;
+        for (std::wstring &path : paths)
+            m_roots.push_back(std::move(path));
+        return true;
+    }
+
+    DropStats m_getStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto end = m_isFinished ? m_endTime : std::chrono::steady_clock::now();
+        return { m_count.load(), (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - m_startTime).count() };
     }
 
-    int m_posX, m_posY;
-    int m_width, m_height;
-    bool m_isResizeable;
-    DWORD m_style;
-    LPCWSTR m_title;
-    bool m_isRunning;
-    std::vector<IElement *> m_elements;
-    void (*m_onExit)();
+    void m_run() {
+        std::vector<std::wstring> batch;
+        std::vector<std::wstring> directories;
+        ULONGLONG lastFlush = GetTickCount64();
+        WIN32_FIND_DATA data;
+        while (!m_isCancelled) {
+            std::wstring path;
+            if (!directories.empty()) {
+                path = std::move(directories.back());
+                directories.pop_back();
+            } else {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_roots.empty()) {
+                    lock.unlock();
+                    if (m_flush(batch, true))
+                        return;
+                    continue;
+                }
+                path = std::move(m_roots.front());
+                m_roots.pop_front();
+                lock.unlock();
+                DWORD attributes = GetFileAttributes(path.c_str());
+                if (attributes == INVALID_FILE_ATTRIBUTES)
+                    continue;
+                if (!(attributes & FILE_ATTRIBUTE_DIRECTORY) || !m_isRecursive) {
+                    m_add(batch, std::move(path), lastFlush);
+                    continue;
+                }
+            }
+
+            // FindExInfoBasic не заполняет короткие имена, а LARGE_FETCH уменьшает число обращений к ФС
+            if (path.back() != L'\\')
+                path += L'\\';
+            size_t prefix = path.size();
+            path += L'*';
+            HANDLE find = FindFirstFileEx(path.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+            path.resize(prefix);
+            if (find == INVALID_HANDLE_VALUE)
+                continue;
+            do {
+                const wchar_t *name = data.cFileName;
+                if (name[0] == L'.' && (name[1] == L'\0' || (name[1] == L'.' && name[2] == L'\0')))
+                    continue;
+                std::wstring child = path + name;
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    directories.push_back(std::move(child));
+                else
+                    m_add(batch, std::move(child), lastFlush);
+            } while (!m_isCancelled && FindNextFile(find, &data));
+            FindClose(find);
+        }
+    }
+
+    void m_add(std::vector<std::wstring> &batch, std::wstring &&path, ULONGLONG &lastFlush) {
+        batch.push_back(std::move(path));
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        if (batch.size() < s_batchSize && GetTickCount64() - lastFlush < s_batchInterval)
+            return;
+        m_flush(batch, false);
+        lastFlush = GetTickCount64();
+    }
+
+    // Пока окно не забрало предыдущую пачку, новые пути дописываются к ней без нового сообщения. Если окно не успевает
+    // и ждут уже s_maxReady путей, обход останавливается до следующего _m_onDropBatch, и память не растёт без предела.
+    // Возвращает T, если обход завершён
+    bool m_flush(std::vector<std::wstring> &batch, bool isFinal) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // Сообщение о непустых готовых путях уже отправлено, поэтому окно их заберёт
+        m_taken.wait(lock, [this]() { return m_ready.size() < s_maxReady || m_isCancelled; });
+        if (m_ready.empty()) {
+            m_ready.swap(batch);
+        } else {
+            m_ready.insert(m_ready.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            batch.clear();
+        }
+        if (isFinal) {
+            // Корни, добавленные во время последней проверки, обходятся этим же потоком
+            if (!m_roots.empty())
+                return false;
+            m_isFinished = true;
+            m_endTime = std::chrono::steady_clock::now();
+        }
+        if (!m_isPosted && (isFinal || !m_ready.empty())) {
+            m_isPosted = true;
+            PostMessage(m_window, _M_EZW32_WM_DROP_BATCH, (WPARAM)m_elemId, (LPARAM)NULL);
+        }
+        return m_isFinished;
+    }
 };
+template struct _M_HiddenDelete<_M_FileIntake>;
+
+void ListBox::cancelDrop() {
+    if (!m_intake)
+        return;
+    m_intake->m_isCancelled = true;
+    m_dropStats = m_intake->m_getStats();
+    m_intake.reset();
+}
+
+DropStats ListBox::getDropStats() const {
+    return m_intake ? m_intake->m_getStats() : m_dropStats;
+}
+
+void ListBox::_m_onDrop(HWND window, std::vector<std::wstring> &&paths) {
+    if (m_intake && m_intake->m_append(paths))
+        return;
+    if (m_intake) {
+        // Предыдущий приём уже отправил последнюю пачку, но окно её ещё не забрало
+        _m_onDropBatch();
+    }
+    m_intake.reset(new _M_FileIntake(window, m_id, m_isDropRecursive));
+    m_intake->m_append(paths);
+    _M_FileIntake *intake = m_intake.get();
+    m_intake->m_thread = std::thread([intake]() { intake->m_run(); });
+}
+
+void ListBox::_m_onDropBatch() {
+    if (!m_intake)
+        return;
+    std::vector<std::wstring> batch;
+    bool isFinished;
+    {
+        std::lock_guard<std::mutex> lock(m_intake->m_mutex);
+        batch.swap(m_intake->m_ready);
+        m_intake->m_isPosted = false;
+        isFinished = m_intake->m_isFinished;
+    }
+    m_intake->m_taken.notify_one();
+    if (!batch.empty())
+        addItems(std::move(batch));
+    if (!isFinished)
+        return;
+    m_dropStats = m_intake->m_getStats();
+    m_intake.reset();
+    if (m_onDropDone)
+        m_onDropDone(*this);
+}
+
+// Хэш и сравнение читают символы из хранилища, поэтому таблица ищет как по _M_Span, так и по std::wstring_view
+struct _M_ItemStore::_M_InternTable {
+    struct _M_Hash {
+        using is_transparent = void;
+        const _M_ItemStore *m_store;
+        size_t operator ()(std::wstring_view text) const { return std::hash<std::wstring_view>()(text); }
+        size_t operator ()(_M_Span span) const { return (*this)(m_store->m_view(span)); }
+    };
+    struct _M_Equal {
+        using is_transparent = void;
+        const _M_ItemStore *m_store;
+        std::wstring_view m_text(std::wstring_view text) const { return text; }
+        std::wstring_view m_text(_M_Span span) const { return m_store->m_view(span); }
+        template <class A, class B>
+        bool operator ()(const A &a, const B &b) const { return m_text(a) == m_text(b); }
+    };
 
-_M_AppData _m_appData = {
-    .m_posX          = CW_USEDEFAULT,
-    .m_posY          = CW_USEDEFAULT,
-    .m_width         = CW_USEDEFAULT,
-    .m_height        = CW_USEDEFAULT,
-    .m_isResizeable  = false,
-    .m_style         = WS_OVERLAPPEDWINDOW & ~WS_THICKFRAME,
-    .m_title         = L"window title",
-    .m_elements      = { },
-    .m_onExit        = nullptr
+    std::unordered_map<_M_Span, uint32_t, _M_Hash, _M_Equal> m_refs;
+
+    _M_InternTable(const _M_ItemStore *store) : m_refs(0, _M_Hash{ store }, _M_Equal{ store }) { }
 };
+template struct _M_HiddenDelete<_M_ItemStore::_M_InternTable>;
 
-/**
- * @brief Устанавливает функцию, которая запускается при выходе из программы
- * @param onExit указатель на функцию
- */
-void setAppOnExit(void (*onExit)()) {
-    _m_appData.m_onExit = onExit;
+_M_ItemStore::_M_Span _M_ItemStore::m_intern(std::wstring_view text) {
+    if (!m_interned)
+        m_interned.reset(new _M_InternTable(this));
+    auto it = m_interned->m_refs.find(text);
+    if (it != m_interned->m_refs.end()) {
+        it->second++;
+        return it->first;
+    }
+    _M_Span span = m_store(text);
+    m_interned->m_refs.emplace(span, 1);
+    return span;
 }
-/**
- * @brief Установить положение окна на экране
- * @param x X-координата
- * @param y Y-координата
- */
-void setWindowPosition(DWORD x, DWORD y) {
-    _m_appData.m_posX = x;
-    _m_appData.m_posY = y;
+
+bool _M_ItemStore::m_unref(_M_Span span) {
+    auto it = m_interned->m_refs.find(span);
+    if (--it->second)
+        return false;
+    m_interned->m_refs.erase(it);
+    return true;
 }
-/**
- * @brief Установить размер окна
- * @param width ширина (X-размер)
- * @param height высота (Y-размер)
- */
-void setWindowSize(DWORD width, DWORD height) {
-    _m_appData.m_width = width;
-    _m_appData.m_height = height;
+
+size_t _M_ItemStore::m_internedBytes() const {
+    return m_interned ? m_interned->m_refs.size() * (sizeof(std::pair<_M_Span, uint32_t>) + 2 * sizeof(void *)) : 0;
 }
-/**
- * @brief Установить название окна
- * @param title название
- */
-void setWindowTitle(LPCWSTR title) {
-    _m_appData.m_title = title;
+
+void _m_parallelFor(size_t count, _M_TaskRef func) {
+    std::vector<std::thread> workers;
+    workers.reserve(count ? count - 1 : 0);
+    for (size_t i = 0; i + 1 < count; i++)
+        workers.emplace_back(func, i);
+    if (count)
+        func(count - 1);
+    for (std::thread &worker : workers)
+        worker.join();
 }
-/**
- * @brief Установить стиль окна
- * @param style флаги стилей (DWORD)
- */
-void setWindowStyle(DWORD style) {
-    _m_appData.m_style = style;
+
+size_t _m_parallelChunks(size_t count, size_t minChunk) {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(cores, count / minChunk));
 }
-/**
- * @brief Установить возможность измены размера окна
- * @param value T/F
- */
-void setWindowResizeable(bool value) {
-    _m_appData.m_isResizeable = value;
-    if (_m_appData.m_isResizeable)
-        _m_appData.m_style |= WS_THICKFRAME;
-    else
-        _m_appData.m_style &= ~WS_THICKFRAME;
+
+void _m_acceptDroppedFiles(HWND window) {
+    DragAcceptFiles(window, TRUE);
 }
 
-/**
- * @brief Получить ширину экрана
- * @return ширина экрана
- */
-int getScreenWidth() { return GetSystemMetrics(SM_CXSCREEN); }
-/**
- * @brief Получить высоту экрана
- * @return высота экрана
- */
-int getScreenHeight() { return GetSystemMetrics(SM_CYSCREEN); }
+template <class T>
+struct _M_ComPtr {
+    T *m_ptr = nullptr;
 
-/**
- * @brief Добавить статичный текстовый элемент
- * @param posX X-координата
- * @param posY Y-координата
- * @param width ширина
- * @param height высота
- * @param text текст = ""
- * @param alignText выравнивание = Center
- * @return Ссылка на добавленный статичный текстовый элемент
- */
-Static &addStatic(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", Align alignText = Align::Center) {
-    Static *newStatic = new Static(posX, posY, width, height, text, alignText);
-    _m_appData.m_elements.push_back(dynamic_cast<IElement *>(newStatic));
-    return *newStatic;
+    _M_ComPtr() = default;
+    _M_ComPtr(const _M_ComPtr &) = delete;
+    _M_ComPtr &operator =(const _M_ComPtr &) = delete;
+    ~_M_ComPtr() { if (m_ptr) m_ptr->Release(); }
+
+    T *operator ->() const { return m_ptr; }
+    T **operator &() { return &m_ptr; }
+};
+
+static std::shared_ptr<_M_ImageBitmap> _m_decodeImage(IWICImagingFactory *factory, const ImageCache::_M_Job &job) {
+    _M_ComPtr<IWICStream> stream;
+    _M_ComPtr<IWICBitmapDecoder> decoder;
+    HRESULT hr;
+    if (job.m_data) {
+        hr = factory->CreateStream(&stream);
+        if (SUCCEEDED(hr))
+            hr = stream->InitializeFromMemory((BYTE *)job.m_data->data(), (DWORD)job.m_data->size());
+        if (SUCCEEDED(hr))
+            hr = factory->CreateDecoderFromStream(stream.m_ptr, NULL, WICDecodeMetadataCacheOnDemand, &decoder);
+    } else {
+        hr = factory->CreateDecoderFromFilename(job.m_source.c_str(), NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+    }
+    _M_ComPtr<IWICBitmapFrameDecode> frame;
+    _M_ComPtr<IWICFormatConverter> converter;
+    if (SUCCEEDED(hr))
+        hr = decoder->GetFrame(0, &frame);
+    if (SUCCEEDED(hr))
+        hr = factory->CreateFormatConverter(&converter);
+    if (SUCCEEDED(hr))
+        hr = converter->Initialize(frame.m_ptr, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+    auto bitmap = std::make_shared<_M_ImageBitmap>();
+    if (SUCCEEDED(hr))
+        hr = converter->GetSize(&bitmap->m_width, &bitmap->m_height);
+    if (FAILED(hr))
+        return nullptr;
+    bitmap->m_bytes = (size_t)bitmap->m_width * bitmap->m_height * 4;
+    bitmap->m_pixels.resize(bitmap->m_bytes);
+    if (FAILED(converter->CopyPixels(NULL, bitmap->m_width * 4, (UINT)bitmap->m_bytes, bitmap->m_pixels.data())))
+        return nullptr;
+    return bitmap;
 }
-/**
- * @brief Добавить кнопку
- * @param posX X-координата
- * @param posY Y-координата
- * @param width ширина
- * @param height высота
- * @param text текст = ""
- * @param onClick ответная функция на нажатие = NULL
- * @param alignText выравнивание = Center
- * @return Ссылка на добавленную кнопку
- */
-Button &addButton(SHORT posX, SHORT posY, SHORT width, SHORT height, const std::wstring &text = L"", FuncCall<Button> onClick = nullptr, Align alignText = Align::Center) {
-    Button *newBtn = new Button(posX, posY, width, height, text, onClick, alignText);
-    _m_appData.m_elements.push_back(dynamic_cast<IElement *>(newBtn));
-    return *newBtn;
+
+static std::shared_ptr<_M_ImageBitmap> _m_scaleImage(IWICImagingFactory *factory, const _M_ImageBitmap &source, UINT width, UINT height) {
+    BITMAPINFO info = { };
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = (LONG)width;
+    info.bmiHeader.biHeight = -(LONG)height;    // строки сверху вниз, как у WIC
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    void *bits = nullptr;
+    auto bitmap = std::make_shared<_M_ImageBitmap>();
+    bitmap->m_bitmap = CreateDIBSection(NULL, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (!bitmap->m_bitmap)
+        return nullptr;
+    bitmap->m_width = width;
+    bitmap->m_height = height;
+    bitmap->m_bytes = (size_t)width * height * 4;
+    if (width == source.m_width && height == source.m_height) {
+        std::memcpy(bits, source.m_pixels.data(), bitmap->m_bytes);
+        return bitmap;
+    }
+    _M_ComPtr<IWICBitmap> wicSource;
+    _M_ComPtr<IWICBitmapScaler> scaler;
+    HRESULT hr = factory->CreateBitmapFromMemory(source.m_width, source.m_height, GUID_WICPixelFormat32bppPBGRA,
+        source.m_width * 4, (UINT)source.m_pixels.size(), (BYTE *)source.m_pixels.data(), &wicSource);
+    if (SUCCEEDED(hr))
+        hr = factory->CreateBitmapScaler(&scaler);
+    if (SUCCEEDED(hr))
+        hr = scaler->Initialize(wicSource.m_ptr, width, height, WICBitmapInterpolationModeFant);
+    if (SUCCEEDED(hr))
+        hr = scaler->CopyPixels(NULL, width * 4, (UINT)bitmap->m_bytes, (BYTE *)bits);
+    return SUCCEEDED(hr) ? bitmap : nullptr;
 }
-/**
- * @brief Добавить элемент текстового ввода
- * @param posX X-координата
- * @param posY Y-координата
- * @param width ширина
- * @param height высота
- * @param isNumberOnly только численный ввод (T/F) = F
- * @param alignText выравнивание текста = Left
- * @param presetText начальный текст = ""
- * @return Ссылка на добавленный элемент текстового ввода
- */
-Edit &addEdit(SHORT posX, SHORT posY, SHORT width, SHORT height, bool isNumberOnly = false, Align alignText = Align::Left, const std::wstring &presetText = L"") {
-    Edit *newEdit = new Edit(posX, posY, width, height, isNumberOnly, alignText, presetText);
-    _m_appData.m_elements.push_back(dynamic_cast<IElement *>(newEdit));
-    return *newEdit;
+
+struct ImageCache::_M_Entry {
+    std::wstring m_key;
+    std::shared_ptr<_M_ImageBitmap> m_bitmap;
+};
+
+struct ImageCache::_M_State {
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_worker;
+    bool m_isStopping = false;
+    std::deque<_M_Job> m_jobs;
+    std::unordered_map<uint64_t, _M_Result> m_results;
+    uint64_t m_activeElemId = 0;
+    bool m_isActiveCancelled = false;
+
+    std::list<_M_Entry> m_lru;      // в начале - последние использованные
+    std::unordered_map<std::wstring, std::list<_M_Entry>::iterator> m_index;
+    size_t m_bytes = 0;
+    size_t m_budget = 64 << 20;
+    ImageCacheStats m_stats = { };
+
+    // Поиск не учитывается в статистике: каждое задание загрузчика засчитывается один раз, как попадание или промах
+    std::shared_ptr<_M_ImageBitmap> m_find(const std::wstring &key) {
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return nullptr;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->m_bitmap;
+    }
+    void m_insert(const std::wstring &key, std::shared_ptr<_M_ImageBitmap> bitmap) {
+        if (m_index.count(key))
+            return;
+        m_bytes += bitmap->m_bytes;
+        m_lru.push_front({ key, std::move(bitmap) });
+        m_index.emplace(key, m_lru.begin());
+        m_evict();
+    }
+    // Последняя добавленная запись остаётся, даже если она одна больше бюджета
+    void m_evict() {
+        while (m_bytes > m_budget && m_lru.size() > 1) {
+            m_bytes -= m_lru.back().m_bitmap->m_bytes;
+            m_index.erase(m_lru.back().m_key);
+            m_lru.pop_back();
+        }
+    }
+};
+
+// Состояние не разрушается при выходе: элементы главного окна удаляются позже статических объектов
+ImageCache::_M_State &ImageCache::s_state() {
+    static _M_State *state = new _M_State();
+    return *state;
 }
-/**
- * @brief Добавить элемент списка
- * @param posX X-координата
- * @param posY Y-координата
- * @param width ширина
- * @param height высота
- */
-ListBox &addListBox(SHORT posX, SHORT posY, SHORT width, SHORT height, FuncCall<ListBox> onSelect = nullptr) {
-    ListBox *newList = new ListBox(posX, posY, width, height, onSelect);
-    _m_appData.m_elements.push_back(dynamic_cast<IElement *>(newList));
-    return *newList;
+
+void ImageCache::setBudget(size_t bytes) {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    state.m_budget = bytes;
+    state.m_evict();
 }
 
-/**
- * @brief Энумерация стандартных звуков Windows
- */
-enum class WindowsSound { Warning, Error };
+size_t ImageCache::getBudget() {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    return state.m_budget;
+}
 
-/**
- * @brief Проиграть стандартный звук Windows
- * @param sound звук
- */
-void playWindowsSound(WindowsSound sound) {
-    switch (sound) {
-    case WindowsSound::Warning: MessageBeep(MB_ICONWARNING);    break;
-    case WindowsSound::Error:   MessageBeep(MB_ICONERROR);      break;
-    default: break;
+ImageCacheStats ImageCache::getStats() {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    ImageCacheStats stats = state.m_stats;
+    stats.entries = state.m_lru.size();
+    stats.bytes = state.m_bytes;
+    stats.budget = state.m_budget;
+    return stats;
+}
+
+void ImageCache::clear() {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    state.m_lru.clear();
+    state.m_index.clear();
+    state.m_bytes = 0;
+    state.m_stats = { };
+}
+
+std::shared_ptr<_M_ImageBitmap> ImageCache::_m_find(const std::wstring &source, UINT width, UINT height) {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    std::shared_ptr<_M_ImageBitmap> bitmap = state.m_find(s_key(source, width, height));
+    // Промах здесь не считается: элемент ставит загрузку в очередь, и её учтёт загрузчик
+    if (bitmap)
+        state.m_stats.hits++;
+    return bitmap;
+}
+
+void ImageCache::_m_request(_M_Job job) {
+    _M_State &state = s_state();
+    {
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        // Задание того же элемента, ещё не взятое потоком, заменяется новым
+        for (_M_Job &queued : state.m_jobs)
+            if (queued.m_elemId == job.m_elemId) {
+                queued = std::move(job);
+                return;
+            }
+        if (state.m_isStopping)
+            return;
+        state.m_jobs.push_back(std::move(job));
+        if (!state.m_worker.joinable())
+            state.m_worker = std::thread(s_work);
     }
+    state.m_wake.notify_one();
 }
 
-/**
- * @brief Функция инициализации элементов окна, вызывается автоматически (один раз)
- * @warning Функция должна быть определена в файле приложения, иначе код не скомпилируется
- */
-extern void Initialize();
+bool ImageCache::_m_take(uint64_t elemId, uint64_t generation, _M_Result &result) {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    auto it = state.m_results.find(elemId);
+    if (it == state.m_results.end())
+        return false;
+    bool isCurrent = (it->second.m_generation == generation);
+    if (isCurrent)
+        result = std::move(it->second);
+    state.m_results.erase(it);
+    return isCurrent;
+}
 
-} // namespace easywindows32
+void ImageCache::_m_cancel(uint64_t elemId) {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    std::erase_if(state.m_jobs, [elemId](const _M_Job &job) { return job.m_elemId == elemId; });
+    state.m_results.erase(elemId);
+    if (state.m_activeElemId == elemId)
+        state.m_isActiveCancelled = true;
+}
 
-LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+void ImageCache::_m_shutdown() {
+    _M_State &state = s_state();
+    {
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        state.m_isStopping = true;
+        state.m_jobs.clear();
+    }
+    state.m_wake.notify_one();
+    if (state.m_worker.joinable())
+        state.m_worker.join();
+}
+
+void ImageCache::s_work() {
+    _M_State &state = s_state();
+    HRESULT comResult = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    _M_ComPtr<IWICImagingFactory> factory;
+    CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory.m_ptr));
+
+    std::unique_lock<std::mutex> lock(state.m_mutex);
+    while (true) {
+        state.m_wake.wait(lock, [&state]() { return state.m_isStopping || !state.m_jobs.empty(); });
+        if (state.m_isStopping)
+            break;
+        _M_Job job = std::move(state.m_jobs.front());
+        state.m_jobs.pop_front();
+        state.m_activeElemId = job.m_elemId;
+        state.m_isActiveCancelled = false;
+
+        std::wstring sourceKey = s_key(job.m_source, 0, 0);
+        std::shared_ptr<_M_ImageBitmap> source = state.m_find(sourceKey);
+        if (!source && factory.m_ptr) {
+            lock.unlock();
+            source = _m_decodeImage(factory.m_ptr, job);
+            lock.lock();
+            if (source)
+                state.m_insert(sourceKey, source);
+        }
+        _M_Result result = { job.m_generation, nullptr, 0, 0 };
+        bool isHit = false;
+        if (source) {
+            UINT width, height;
+            s_fit(source->m_width, source->m_height, job.m_boxWidth, job.m_boxHeight, width, height);
+            std::wstring variantKey = s_key(job.m_source, width, height);
+            result.m_bitmap = state.m_find(variantKey);
+            isHit = (result.m_bitmap != nullptr);
+            if (!result.m_bitmap) {
+                lock.unlock();
+                result.m_bitmap = _m_scaleImage(factory.m_ptr, *source, width, height);
+                lock.lock();
+                if (result.m_bitmap)
+                    state.m_insert(variantKey, result.m_bitmap);
+            }
+            result.m_sourceWidth = source->m_width;
+            result.m_sourceHeight = source->m_height;
+        }
+        if (isHit)
+            state.m_stats.hits++;
+        else
+            state.m_stats.misses++;
+        state.m_activeElemId = 0;
+        if (state.m_isActiveCancelled)
+            continue;
+        state.m_results[job.m_elemId] = std::move(result);
+        PostMessage(job.m_window, _M_EZW32_WM_IMAGE_LOADED, (WPARAM)job.m_elemId, (LPARAM)NULL);
+    }
+    lock.unlock();
+    if (factory.m_ptr) {
+        factory.m_ptr->Release();
+        factory.m_ptr = nullptr;
+    }
+    if (SUCCEEDED(comResult))
+        CoUninitialize();
+}
+
+struct EventRecorder::_M_State {
+    std::mutex m_mutex;
+    std::atomic<bool> m_isActive = false;
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_startTime = 0, m_lastTime = 0;
+
+    // Запись, не завершённая stop(), дописывается при выходе из программы
+    ~_M_State() {
+        if (!m_isActive)
+            return;
+        m_flush();
+        CloseHandle(m_file);
+    }
+
+    void m_flush() {
+        DWORD written = 0;
+        if (!m_buffer.empty())
+            WriteFile(m_file, m_buffer.data(), (DWORD)m_buffer.size(), &written, NULL);
+        m_buffer.clear();
+    }
+};
+
+EventRecorder::_M_State &EventRecorder::s_state() {
+    static _M_State state;
+    return state;
+}
+
+bool EventRecorder::start(const std::wstring &path) {
+    stop();
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    state.m_file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (state.m_file == INVALID_HANDLE_VALUE)
+        return false;
+    state.m_buffer.assign(s_magic, s_magic + sizeof(s_magic));
+    state.m_buffer.push_back((uint8_t)(s_version & 0xFF));
+    state.m_buffer.push_back((uint8_t)(s_version >> 8));
+    state.m_startTime = state.m_lastTime = _m_microseconds();
+    state.m_isActive = true;
+    return true;
+}
+
+void EventRecorder::stop() {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    if (!state.m_isActive)
+        return;
+    state.m_isActive = false;
+    state.m_flush();
+    CloseHandle(state.m_file);
+    state.m_file = INVALID_HANDLE_VALUE;
+}
+
+bool EventRecorder::isRecording() {
+    return s_state().m_isActive;
+}
+
+void EventRecorder::_m_record(RecordedEventType type, uint32_t window, uint64_t element, int64_t value, std::wstring_view text,
+                              std::span<const uint32_t> selection, uint64_t startTime, uint64_t handlerTime) {
+    _M_State &state = s_state();
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    if (!state.m_isActive)
+        return;
+    uint64_t time = std::max(startTime, state.m_lastTime);
+    std::vector<uint8_t> &out = state.m_buffer;
+    out.push_back((uint8_t)type);
+    s_writeVarint(out, time - state.m_lastTime);
+    s_writeVarint(out, window);
+    s_writeVarint(out, element);
+    s_writeVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    s_writeVarint(out, handlerTime);
+    if (type == RecordedEventType::TextChange) {
+        s_writeVarint(out, text.size());
+        for (wchar_t ch : text) {
+            out.push_back((uint8_t)(ch & 0xFF));
+            out.push_back((uint8_t)((ch >> 8) & 0xFF));
+        }
+    }
+    if (type == RecordedEventType::MultiSelect) {
+        // Индексы идут по возрастанию, поэтому пишется разность с предыдущим индексом + 1 (серия подряд - нули)
+        s_writeVarint(out, selection.size());
+        uint64_t next = 0;
+        for (uint32_t index : selection) {
+            s_writeVarint(out, index - next);
+            next = (uint64_t)index + 1;
+        }
+    }
+    state.m_lastTime = time;
+    if (out.size() >= (1 << 16))
+        state.m_flush();
+}
+
+std::vector<ReplayResult> EventReplayer::replay(const std::vector<RecordedEvent> &events, bool isRealTime) {
+    std::vector<ReplayResult> results;
+    results.reserve(events.size());
+    auto start = std::chrono::steady_clock::now();
+    for (const RecordedEvent &event : events) {
+        if (isRealTime)
+            std::this_thread::sleep_until(start + std::chrono::microseconds(event.time));
+        Window *window = _m_getWindowByIndex(event.window);
+        HWND hWnd = window ? window->getHandle() : NULL;
+        if (!hWnd)
+            continue;
+        if (event.type == RecordedEventType::Resize) {
+            int width = (int)(event.value >> 16), height = (int)(event.value & 0xFFFF);
+            RECT client, frame;
+            GetClientRect(hWnd, &client);
+            if (client.right - client.left != width || client.bottom - client.top != height) {
+                // Окно получает записанный размер клиентской области; WM_SIZE оно присылает само
+                GetWindowRect(hWnd, &frame);
+                width += (frame.right - frame.left) - (client.right - client.left);
+                height += (frame.bottom - frame.top) - (client.bottom - client.top);
+                SetWindowPos(hWnd, NULL, 0, 0, width, height, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+            } else {
+                SendMessage(hWnd, WM_SIZE, (WPARAM)0, MAKELPARAM(width, height));
+            }
+            results.push_back({ event, window->getLastHandlerTime() });
+            continue;
+        }
+        IElement *elem = window->findElement(event.element);
+        HWND control = elem ? elem->getHandle() : NULL;
+        if (!control)
+            continue;
+        switch (event.type) {
+        case RecordedEventType::Click:
+            SendMessage(hWnd, WM_COMMAND, MAKEWPARAM(event.element, BN_CLICKED), (LPARAM)control);
+            break;
+        case RecordedEventType::Select:
+            SendMessage(control, LB_SETCURSEL, (WPARAM)event.value, (LPARAM)NULL);
+            SendMessage(hWnd, WM_COMMAND, MAKEWPARAM(event.element, LBN_SELCHANGE), (LPARAM)control);
+            break;
+        case RecordedEventType::MultiSelect:
+            // LB_SETCURSEL не работает в списках с множественным выбором: набор передаётся через LB_SETSEL
+            SendMessage(control, LB_SETSEL, (WPARAM)FALSE, (LPARAM)(-1));
+            ListBox::_m_sendSelection(control, event.selection);
+            SendMessage(hWnd, WM_COMMAND, MAKEWPARAM(event.element, LBN_SELCHANGE), (LPARAM)control);
+            break;
+        case RecordedEventType::TextChange:
+            // EN_CHANGE приходит в окно само, синхронно с WM_SETTEXT
+            SendMessage(control, WM_SETTEXT, (WPARAM)NULL, (LPARAM)event.text.c_str());
+            break;
+        default:
+            break;
+        }
+        results.push_back({ event, window->getLastHandlerTime() });
+    }
+    return results;
+}
+
+struct Window::_M_State {
+    std::thread m_thread;
+    std::unordered_map<uint64_t, IElement *> m_dispatch;
+};
+template struct _M_HiddenDelete<Window::_M_State>;
+
+Window::Window(LPCWSTR title) :
+    m_posX(CW_USEDEFAULT), m_posY(CW_USEDEFAULT),
+    m_width(CW_USEDEFAULT), m_height(CW_USEDEFAULT),
+    m_isResizeable(false),
+    m_style(WS_OVERLAPPEDWINDOW & ~WS_THICKFRAME),
+    m_title(title),
+    m_isMain(false),
+    m_isOwnThread(false),
+    m_handle(NULL),
+    m_state(new _M_State()),
+    m_index(0),
+    m_lastHandlerTime(0),
+    m_sampleInterval(33)
+    { }
+
+Window::~Window() {
+    if (m_state->m_thread.joinable()) {
+        close();
+        m_state->m_thread.join();
+    }
+    for (IElement *elem : m_elements)
+        delete elem;
+}
+
+IElement *Window::findElement(uint64_t id) const {
+    auto it = m_state->m_dispatch.find(id);
+    return (it != m_state->m_dispatch.end()) ? it->second : nullptr;
+}
+
+bool Window::open(int showCommand) {
+    if (m_handle)
+        return true;
+    if (!m_isOwnThread)
+        return m_createHandle(showCommand);
+    if (m_state->m_thread.joinable())
+        m_state->m_thread.join();
+    // Обещание переходит в поток: set_value ещё обращается к нему, когда result.get() уже вернулся и open завершилась
+    std::promise<bool> created;
+    std::future<bool> result = created.get_future();
+    m_state->m_thread = std::thread([this, created = std::move(created), showCommand]() mutable {
+        bool isCreated = m_createHandle(showCommand);
+        created.set_value(isCreated);
+        if (isCreated)
+            _m_runMessageLoop();
+    });
+    return result.get();
+}
+
+void Window::m_register(IElement *elem) {
+    m_state->m_dispatch.emplace(elem->getID(), elem);
+    elem->m_anchorVersion = &m_layout.m_anchorVersion;
+}
+
+} // namespace easywindows32
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     using namespace easywindows32;
 
     Initialize();
+    INITCOMMONCONTROLSEX icc = { sizeof(INITCOMMONCONTROLSEX), ICC_STANDARD_CLASSES | ICC_PROGRESS_CLASS | ICC_TREEVIEW_CLASSES };
+    InitCommonControlsEx(&icc);
     // Register the window class
     WNDCLASS wc = {
         .style = 0,
@@ -935,48 +6593,54 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     if (!RegisterClass(&wc))
         return FALSE;
 
-    // Create the window.
-    HWND hWnd = CreateWindow(
-        _M_EZW32_CLASS_NAME,
-        _m_appData.m_title,
-        _m_appData.m_style,
-
-        _m_appData.m_posX,
-        _m_appData.m_posY,
-
-        _m_appData.m_width,
-        _m_appData.m_height,
-
-        NULL,       // Parent window
-        NULL,       // Menu
-        hInstance,  // Instance handle
-        NULL        // Additional application data
-    );
-
-    if (!hWnd) return FALSE;
+    // Create the windows.
+    if (!_m_appData.m_mainWindow.open(nCmdShow))
+        return FALSE;
+    for (auto &window : _m_appData.m_windows)
+        window->open();
 
     // HICON hIcon = LoadIcon(NULL, IDI_EXCLAMATION);
     // SendMessage(hWnd, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
     // SendMessage(hWnd, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
 
-    ShowWindow(hWnd, nCmdShow);
-
     // Run the message loop.
-    MSG msg = { };
-    while (GetMessage(&msg, NULL, 0, 0) > 0) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
-    }
+    WPARAM result = _m_runMessageLoop();
 
-    return msg.wParam;
+    // Close the windows running on their own threads.
+    _m_appData.m_windows.clear();
+    ImageCache::_m_shutdown();
+    EventRecorder::stop();
+
+    return result;
 }
 
 LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     using namespace easywindows32;
+
+    if (uMsg == WM_NCCREATE) {
+        Window *created = (Window *)((CREATESTRUCT *)lParam)->lpCreateParams;
+        SetWindowLongPtr(hWnd, GWLP_USERDATA, (LONG_PTR)created);
+        created->m_handle = hWnd;
+    }
+    Window *window = (Window *)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+    if (!window)
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+
     switch (uMsg) {
     case WM_CREATE:
-        for (IElement *elem : _m_appData.m_elements)
+        for (IElement *elem : window->m_elements)
             elem->create(hWnd);
+        window->m_layout.build(hWnd, window->m_elements);
+        if (!window->m_sampled.empty())
+            SetTimer(hWnd, _M_EZW32_SAMPLE_TIMER_ID, window->m_sampleInterval, NULL);
+        return 0;
+
+    case WM_SIZE:
+        if (wParam != SIZE_MINIMIZED) {
+            uint64_t startTime = _m_microseconds();
+            window->m_layout.resize(window->m_elements, LOWORD(lParam), HIWORD(lParam));
+            _m_finishEvent(window, RecordedEventType::Resize, nullptr, startTime);
+        }
         return 0;
 
     case WM_INITDIALOG:
@@ -987,9 +6651,15 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
             return 0;
 
     case WM_DESTROY:
-        if (_m_appData.m_onExit)
+        if (window->m_onClose)
+            window->m_onClose(*window);
+        if (window->m_isMain && _m_appData.m_onExit)
             (*_m_appData.m_onExit)();
-        PostQuitMessage(0);
+        window->m_handle = NULL;
+        SetWindowLongPtr(hWnd, GWLP_USERDATA, (LONG_PTR)NULL);
+        // Цикл сообщений завершается только у главного окна и у окон с собственным потоком
+        if (window->m_isMain || window->m_isOwnThread)
+            PostQuitMessage(0);
         return 0;
 
     case WM_PAINT:
@@ -1006,30 +6676,139 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
         }
         return 0;
 
-    case WM_COMMAND:
+    case WM_COMMAND: {
+        uint64_t startTime = _m_microseconds();
         if (HIWORD(wParam) == BN_CLICKED) {
-            IElement *elem = _m_appData.m_elements[LOWORD(wParam) - 1];
+            IElement *elem = window->m_findElement((HWND)lParam);
             Button *btn = dynamic_cast<Button *>(elem);
             if (!btn)
                 return 0;
-            FuncCall<Button> func = btn->getOnClick();
-            if (!func)
-                return 0;
-            (*func)(*btn);
+            btn->_m_submitEvent(hWnd);
+            _m_finishEvent(window, RecordedEventType::Click, elem, startTime);
         } else if (HIWORD(wParam) == LBN_SELCHANGE) {
-            IElement *elem = _m_appData.m_elements[LOWORD(wParam) - 1];
+            IElement *elem = window->m_findElement((HWND)lParam);
             ListBox *lb = dynamic_cast<ListBox *>(elem);
             if (!lb)
                 return 0;
-            FuncCall<ListBox> func = lb->getOnSelect();
-            (*func)(*lb);
+            lb->_m_syncSelection();
+            lb->_m_submitEvent(hWnd);
+            _m_finishEvent(window, RecordedEventType::Select, elem, startTime);
+        } else if (HIWORD(wParam) == EN_CHANGE) {
+            IElement *elem = window->m_findElement((HWND)lParam);
+            Edit *edit = dynamic_cast<Edit *>(elem);
+            if (!edit)
+                return 0;
+            edit->_m_onTextChange();
+            _m_finishEvent(window, RecordedEventType::TextChange, elem, startTime);
+        }
+        return 0;
+    }
+
+    case WM_TIMER:
+        if (wParam == _M_EZW32_SAMPLE_TIMER_ID) {
+            for (ISampledElement *elem : window->m_sampled)
+                elem->_m_sample();
+            return 0;
+        }
+        if (wParam & _M_EZW32_TREE_TIMER_FLAG) {
+            if (TreeView *tree = dynamic_cast<TreeView *>(window->findElement(wParam & ~_M_EZW32_TREE_TIMER_FLAG)))
+                tree->_m_onUpdate();
+            else
+                KillTimer(hWnd, wParam);
+            return 0;
+        }
+        if (IElement *elem = window->findElement(wParam))
+            elem->_m_onDeliveryTimer(hWnd);
+        return 0;
+
+    case _M_EZW32_WM_DELIVER_EVENT:
+        if (IElement *elem = window->findElement(wParam))
+            elem->_m_onDeliveryPosted();
+        return 0;
+
+    case _M_EZW32_WM_IMAGE_LOADED:
+        if (Image *image = dynamic_cast<Image *>(window->findElement(wParam)))
+            image->_m_onLoaded();
+        return 0;
+
+    // Файлы получает элемент под курсором, если он принимает перетаскивание
+    case WM_DROPFILES: {
+        HDROP drop = (HDROP)wParam;
+        POINT point = { };
+        DragQueryPoint(drop, &point);
+        HWND child = ChildWindowFromPointEx(hWnd, point, CWP_SKIPINVISIBLE | CWP_SKIPTRANSPARENT);
+        IDropTargetElement *target = dynamic_cast<IDropTargetElement *>(window->m_findElement(child != hWnd ? child : NULL));
+        if (target && target->_m_acceptsDrop()) {
+            UINT count = DragQueryFile(drop, 0xFFFFFFFF, NULL, 0);
+            std::vector<std::wstring> paths(count);
+            for (UINT i = 0; i < count; i++) {
+                paths[i].resize(DragQueryFile(drop, i, NULL, 0));
+                DragQueryFile(drop, i, paths[i].data(), (UINT)paths[i].size() + 1);
+            }
+            target->_m_onDrop(hWnd, std::move(paths));
         }
+        DragFinish(drop);
+        return 0;
+    }
+
+    case _M_EZW32_WM_DROP_BATCH:
+        if (ListBox *lb = dynamic_cast<ListBox *>(window->findElement(wParam)))
+            lb->_m_onDropBatch();
+        return 0;
+
+    case WM_NOTIFY: {
+        const NMHDR *header = (const NMHDR *)lParam;
+        TreeView *tree = dynamic_cast<TreeView *>(window->m_findElement(header->hwndFrom));
+        if (!tree)
+            break;
+        if (header->code != TVN_SELCHANGED)
+            return tree->_m_notify(*header);
+        uint64_t startTime = _m_microseconds();
+        tree->_m_notify(*header);
+        tree->_m_submitEvent(hWnd);
+        // Выбор узла не записывается (EventRecorder хранит выделение как номер строки ListBox)
+        window->m_lastHandlerTime = _m_microseconds() - startTime;
+        return 0;
+    }
+
+    case _M_EZW32_WM_TREE_UPDATE:
+        if (TreeView *tree = dynamic_cast<TreeView *>(window->findElement(wParam)))
+            tree->_m_onUpdate();
         return 0;
 
+    case WM_DRAWITEM: {
+        const DRAWITEMSTRUCT *draw = (const DRAWITEMSTRUCT *)lParam;
+        IOwnerDrawElement *elem = dynamic_cast<IOwnerDrawElement *>(window->m_findElement(draw->hwndItem));
+        if (!elem)
+            break;
+        elem->_m_drawItem(*draw);
+        return TRUE;
+    }
+
+    // Приходит во время создания элемента, когда у него ещё нет дескриптора, поэтому поиск идёт по ИД
+    case WM_MEASUREITEM: {
+        MEASUREITEMSTRUCT *measure = (MEASUREITEMSTRUCT *)lParam;
+        IOwnerDrawElement *elem = dynamic_cast<IOwnerDrawElement *>(window->findElement(measure->CtlID));
+        if (!elem)
+            break;
+        elem->_m_measureItem(*measure);
+        return TRUE;
+    }
+
+    case WM_CTLCOLOREDIT:
+        if (Edit *edit = dynamic_cast<Edit *>(window->m_findElement((HWND)lParam)))
+            if (HBRUSH brush = edit->_m_onCtlColor((HDC)wParam))
+                return (LRESULT)brush;
+        break;
+
     case WM_CTLCOLORSTATIC: {
+        // Приходит при каждой перерисовке (Meter - до 30 раз в секунду), поэтому кисть создаётся один раз
+        static HBRUSH brush = CreateSolidBrush(0xFFFFFF);
         SetBkMode((HDC)wParam, TRANSPARENT);
-        return (LRESULT)CreateSolidBrush(0xFFFFFF);                     
+        return (LRESULT)brush;
     }
     }
     return DefWindowProc(hWnd, uMsg, wParam, lParam);
 }
+
+#endif // _M_EZW32_IMPLEMENT
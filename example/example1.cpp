@@ -2,25 +2,36 @@
 
 using namespace easywindows32;
 
-REdit    edit1;
-REdit    edit2;
-RButton  btnSolve;
-RStatic  staticRes;
+RNumericEdit<int>   edit1;
+RNumericEdit<int>   edit2;
+RButton             btnSolve;
+RStatic             staticRes;
 
 void clicked_BtnSolve(easywindows32::Button &btn) {
-    int num1 = std::stoi(edit1->getText());
-    int num2 = std::stoi(edit2->getText());
-    staticRes->setText(std::to_wstring(num1 + num2));
+    if (!edit1->isValid() || !edit2->isValid()) {
+        playWindowsSound(WindowsSound::Warning);
+        return;
+    }
+    staticRes->setText(std::to_wstring((int64_t)edit1->getValue() + edit2->getValue()));
 }
 
 Font mainFont(L"Arial", 25);
 
+constexpr auto layout = computeLayout(
+    layoutColumn(15, LayoutAlign::Center,
+        layoutRow(10, layoutCell(160, 30), layoutCell(160, 30)),
+        layoutCell(160, 30),
+        layoutCell(160, 30)
+    ),
+    35, 80
+);
+
 void easywindows32::Initialize() {
     setWindowSize(400, 300);
     setWindowTitle(L"Adder");
     IElement::setFontDefault(mainFont);
-    edit1       = addEdit(35, 80, 160, 30, true, Align::Center, L"0");
-    edit2       = addEdit(205, 80, 160, 30, true, Align::Center, L"0");
-    btnSolve    = addButton(120, 125, 160, 30, L"Add", clicked_BtnSolve);
-    staticRes   = addStatic(120, 170, 160, 30, L"0", Align::Center);
+    edit1       = addNumericEdit<int>(layout[0], INT_MIN, INT_MAX, 0, Align::Center);
+    edit2       = addNumericEdit<int>(layout[1], INT_MIN, INT_MAX, 0, Align::Center);
+    btnSolve    = addButton(layout[2], L"Add", clicked_BtnSolve);
+    staticRes   = addStatic(layout[3], L"0", Align::Center);
 }
@@ -0,0 +1,66 @@
+#include "EasyWindows32.hpp"
+
+#include <chrono>
+
+using namespace easywindows32;
+
+// Время сохранения и восстановления снимка (см. Snapshot) со списком из 1 000 000 элементов.
+// Восстановление читает строки прямо из отображённого в память файла и заполняет дескриптор списка
+
+constexpr size_t itemCount = 1000000;
+const std::wstring snapshotPath = L"example4.snapshot";
+
+RListBox    list;
+RButton     btnFill;
+RButton     btnSave;
+RButton     btnLoad;
+RStatic     staticResult;
+
+template <class F>
+int64_t timeMs(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void btnFill_onClick(Button &) {
+    std::vector<std::wstring> items;
+    items.reserve(itemCount);
+    for (size_t i = 0; i < itemCount; i++)
+        items.push_back(L"file_" + std::to_wstring(i) + L".txt");
+    int64_t time = timeMs([&items]() {
+        list->clear();
+        list->addItems(std::move(items));
+    });
+    staticResult->setText(L"Fill: " + std::to_wstring(time) + L" ms");
+}
+
+void btnSave_onClick(Button &) {
+    bool isSaved = false;
+    int64_t time = timeMs([&isSaved]() { isSaved = saveSnapshot(snapshotPath); });
+    staticResult->setText(isSaved ? L"Save: " + std::to_wstring(time) + L" ms" : L"Save failed");
+}
+
+void btnLoad_onClick(Button &) {
+    bool isLoaded = false;
+    int64_t time = timeMs([&isLoaded]() { isLoaded = loadSnapshot(snapshotPath); });
+    if (!isLoaded) {
+        staticResult->setText(L"No snapshot");
+        return;
+    }
+    staticResult->setText(L"Load " + std::to_wstring(list->getItemCount()) + L" items: " + std::to_wstring(time) + L" ms");
+}
+
+Font mainFont(L"Arial", 20);
+
+void easywindows32::Initialize() {
+    setWindowSize(500, 300);
+    setWindowTitle(L"Snapshot restore");
+    IElement::setFontDefault(mainFont);
+    list            = addListBox(10, 10, 200, 240);
+    list->setItemStorage(ItemStorage::Packed);
+    btnFill         = addButton(220, 10, 260, 30, L"Fill (1M items)", btnFill_onClick);
+    btnSave         = addButton(220, 50, 260, 30, L"Save snapshot", btnSave_onClick);
+    btnLoad         = addButton(220, 90, 260, 30, L"Load snapshot", btnLoad_onClick);
+    staticResult    = addStatic(220, 130, 260, 30, L"-");
+}
@@ -0,0 +1,67 @@
+#include "EasyWindows32.hpp"
+
+#include <chrono>
+#include <cwchar>
+#include <functional>
+
+using namespace easywindows32;
+
+// Время вызова ответной функции через указатель на функцию, Callback и std::function (10 000 000 вызовов).
+// Обработчики задаются в Initialize, а вызываются по нажатию, поэтому компилятор не может подставить их тело в цикл
+
+constexpr size_t callCount = 10000000;
+
+RButton     btnRun;
+RStatic     staticPointer;
+RStatic     staticCallback;
+RStatic     staticFunction;
+
+uint64_t counter = 0;
+
+void onPointer(Button &) {
+    counter++;
+}
+
+FuncCall<Button>                    pointerHandler;
+Callback<Button>                    callbackHandler;
+std::function<void(Button &)>       functionHandler;
+
+template <class F>
+std::wstring measure(const wchar_t *name, const F &handler) {
+    Button button(0, 0, 0, 0);
+    counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < callCount; i++)
+        handler(button);
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    wchar_t text[64];
+    swprintf(text, 64, L"%ls: %.2f ns/call (%llu)", name, (double)time.count() / callCount, (unsigned long long)counter);
+    return text;
+}
+
+void btnRun_onClick(Button &) {
+    staticPointer->setText(measure(L"Pointer", pointerHandler));
+    staticCallback->setText(measure(L"Callback", callbackHandler));
+    staticFunction->setText(measure(L"std::function", functionHandler));
+}
+
+Font mainFont(L"Arial", 20);
+
+void easywindows32::Initialize() {
+    // Лямбда захватывает 24 байта - столько же, сколько типичный обработчик с указателем на данные и парой параметров.
+    // Callback хранит её в своём буфере; std::function в libstdc++ (буфер 16 байт) выделяет под неё память
+    uint64_t *target = &counter;
+    uint64_t step = 1, mask = ~0ull;
+    pointerHandler = onPointer;
+    callbackHandler = [target, step, mask](Button &) { *target = (*target + step) & mask; };
+    functionHandler = [target, step, mask](Button &) { *target = (*target + step) & mask; };
+
+    setWindowSize(450, 250);
+    setWindowTitle(L"Handler dispatch");
+    IElement::setFontDefault(mainFont);
+    btnRun          = addButton(100, 10, 250, 30, L"Run (10M calls)", btnRun_onClick);
+    staticPointer   = addStatic(10, 60, 430, 30, L"Pointer: -");
+    staticCallback  = addStatic(10, 100, 430, 30, L"Callback: -");
+    staticFunction  = addStatic(10, 140, 430, 30, L"std::function: -");
+}
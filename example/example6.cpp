@@ -0,0 +1,43 @@
+#include "EasyWindows32.hpp"
+
+using namespace easywindows32;
+
+// Окно в собственном потоке не задерживает остальные: пока его обработчик работает 2 секунды, главное окно
+// показывает ход работы и сразу отвечает на нажатия. Время последнего обработчика каждого окна - Window::getLastHandlerTime
+
+Window      *worker = nullptr;
+RButton     btnSlow;
+RMeter      meterProgress;
+RButton     btnRefresh;
+RStatic     staticWorker;
+RStatic     staticMain;
+
+// Вызывается в потоке окна worker
+void btnSlow_onClick(Button &) {
+    for (uint64_t step = 1; step <= 20; step++) {
+        Sleep(100);
+        meterProgress->setValue(step * 5);
+    }
+}
+
+void btnRefresh_onClick(Button &) {
+    staticWorker->setText(L"Worker handler: " + std::to_wstring(worker->getLastHandlerTime()) + L" us");
+    staticMain->setText(L"Main handler: " + std::to_wstring(getMainWindow().getLastHandlerTime()) + L" us");
+}
+
+Font mainFont(L"Arial", 20);
+
+void easywindows32::Initialize() {
+    setWindowSize(400, 250);
+    setWindowTitle(L"Main window");
+    IElement::setFontDefault(mainFont);
+    meterProgress   = addMeter(10, 10, 380, 30, L"Worker progress: ", L" %");
+    btnRefresh      = addButton(100, 50, 200, 30, L"Refresh", btnRefresh_onClick);
+    staticWorker    = addStatic(10, 100, 380, 30, L"Worker handler: -");
+    staticMain      = addStatic(10, 140, 380, 30, L"Main handler: -");
+
+    worker = &addWindow(L"Worker window");
+    worker->setSize(300, 150);
+    worker->setPosition(450, 100);
+    btnSlow         = worker->addButton(50, 40, 200, 30, L"Slow handler (2 s)", btnSlow_onClick);
+}
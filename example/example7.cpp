@@ -0,0 +1,78 @@
+#include "EasyWindows32.hpp"
+
+#include <chrono>
+#include <cwchar>
+
+using namespace easywindows32;
+
+// Скорость перекодирования UTF-8 <-> UTF-16 (utf8ToUtf16, utf16ToUtf8) на буфере 64 МБ: 90% ASCII и 10% кириллицы.
+// "new" - результат каждый раз в новой строке, "reused" - в одной и той же (память уже выделена)
+
+constexpr size_t bufferSize = 64 << 20;
+constexpr int runCount = 5;
+
+RButton     btnRun;
+RStatic     staticToUtf16;
+RStatic     staticToUtf16Reused;
+RStatic     staticToUtf8;
+
+std::string makeText() {
+    const std::string ascii = "The quick brown fox jumps over the lazy dog 0123456789. ";
+    // "Съешь же ещё " (24 байта); экранирование не зависит от кодировки исходного файла
+    const std::string cyrillic = (const char *)u8"\u0421\u044A\u0435\u0448\u044C \u0436\u0435 \u0435\u0449\u0451 ";
+    std::string text;
+    text.reserve(bufferSize + ascii.size() + cyrillic.size());
+    for (size_t i = 0; text.size() < bufferSize; i++)
+        text += (i % 5 == 4) ? cyrillic : ascii;
+    return text;
+}
+
+// Лучшее из runCount повторений, в МБ входных данных в секунду
+template <class F>
+double measure(size_t inputBytes, F convert) {
+    double best = 0;
+    for (int i = 0; i < runCount; i++) {
+        auto start = std::chrono::steady_clock::now();
+        convert();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, inputBytes / 1e6 / seconds);
+    }
+    return best;
+}
+
+std::wstring format(const wchar_t *name, double speed) {
+    wchar_t text[64];
+    swprintf(text, 64, L"%ls: %.0f MB/s", name, speed);
+    return text;
+}
+
+void btnRun_onClick(Button &) {
+    std::string utf8 = makeText();
+    std::wstring utf16;
+    double toUtf16 = measure(utf8.size(), [&utf8]() {
+        std::wstring out;
+        utf8ToUtf16(utf8, out);
+    });
+    double toUtf16Reused = measure(utf8.size(), [&utf8, &utf16]() { utf8ToUtf16(utf8, utf16); });
+    std::string back;
+    double toUtf8 = measure(utf16.size() * sizeof(wchar_t), [&utf16, &back]() { utf16ToUtf8(utf16, back); });
+    if (back != utf8) {
+        staticToUtf8->setText(L"Round trip mismatch");
+        return;
+    }
+    staticToUtf16->setText(format(L"UTF-8 -> UTF-16 (new)", toUtf16));
+    staticToUtf16Reused->setText(format(L"UTF-8 -> UTF-16 (reused)", toUtf16Reused));
+    staticToUtf8->setText(format(L"UTF-16 -> UTF-8 (reused)", toUtf8));
+}
+
+Font mainFont(L"Arial", 20);
+
+void easywindows32::Initialize() {
+    setWindowSize(450, 250);
+    setWindowTitle(L"UTF-8 transcoding");
+    IElement::setFontDefault(mainFont);
+    btnRun                  = addButton(100, 10, 250, 30, L"Run (64 MB)", btnRun_onClick);
+    staticToUtf16           = addStatic(10, 60, 430, 30, L"UTF-8 -> UTF-16 (new): -");
+    staticToUtf16Reused     = addStatic(10, 100, 430, 30, L"UTF-8 -> UTF-16 (reused): -");
+    staticToUtf8            = addStatic(10, 140, 430, 30, L"UTF-16 -> UTF-8 (reused): -");
+}
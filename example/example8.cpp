@@ -0,0 +1,55 @@
+#include "EasyWindows32.hpp"
+
+#include <chrono>
+#include <cwchar>
+
+using namespace easywindows32;
+
+// Скорость приёма перетащенных путей (см. ListBox::setDropTarget): 1 000 000 путей передаются в список так же,
+// как при перетаскивании. Все пути указывают на сам exe, поэтому проверка файла не упирается в диск
+
+constexpr size_t pathCount = 1000000;
+
+RListBox    list;
+RButton     btnRun;
+RStatic     staticWalk;
+RStatic     staticTotal;
+
+std::chrono::steady_clock::time_point startTime;
+
+void list_onDropDone(ListBox &) {
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    DropStats stats = list->getDropStats();
+    wchar_t text[64];
+    swprintf(text, 64, L"Walk: %.0f paths/s", stats.elapsed ? stats.paths * 1e6 / stats.elapsed : 0.0);
+    staticWalk->setText(text);
+    swprintf(text, 64, L"In list: %.0f paths/s", list->getItemCount() / total);
+    staticTotal->setText(text);
+}
+
+void btnRun_onClick(Button &) {
+    if (list->isDropInProgress())
+        return;
+    wchar_t path[MAX_PATH];
+    GetModuleFileName(NULL, path, MAX_PATH);
+    std::vector<std::wstring> paths(pathCount, path);
+    list->clear();
+    staticWalk->setText(L"Walk: ...");
+    staticTotal->setText(L"In list: ...");
+    startTime = std::chrono::steady_clock::now();
+    list->_m_onDrop(getMainWindow().getHandle(), std::move(paths));
+}
+
+Font mainFont(L"Arial", 20);
+
+void easywindows32::Initialize() {
+    setWindowSize(500, 300);
+    setWindowTitle(L"Drop intake");
+    IElement::setFontDefault(mainFont);
+    list            = addListBox(10, 10, 200, 240);
+    list->setItemStorage(ItemStorage::Interned);
+    list->setOnDropDone(list_onDropDone);
+    btnRun          = addButton(220, 10, 260, 30, L"Drop 1M paths", btnRun_onClick);
+    staticWalk      = addStatic(220, 50, 260, 30, L"Walk: -");
+    staticTotal     = addStatic(220, 90, 260, 30, L"In list: -");
+}
@@ -0,0 +1,3 @@
+// Реализация EasyWindows32 для сборки в виде библиотеки (см. EZW32_LIBRARY в EasyWindows32.hpp)
+#define EZW32_IMPLEMENTATION
+#include "EasyWindows32.hpp"